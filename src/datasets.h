@@ -4,6 +4,7 @@
 
 #include <vector>
 #include <cmath>
+#include <random>
 
 typedef pair<uint32_t, double> pid;
 
@@ -0,0 +1,151 @@
+#include "framework/hashing.h"
+#include "framework/sketches.h"
+#include "framework/benchmark.h"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <iomanip>
+
+#include "datasets.h"
+
+using namespace std;
+
+/* ***************************************************
+ * Densification on sparse sets: For sets much
+ * smaller than k most bins are empty. For each set
+ * size this compares the left/right densification
+ * with optimal and fast densification (see
+ * densify.h) by
+ *   - the mean, variance and mean squared error of
+ *     the similarity estimate over many sketches,
+ *   - the time to sketch one set, median over
+ *     repetitions.
+ * All three modes use mixed tabulation and the
+ * same seeds. After each size it prints which mode
+ * was fastest and which had the lowest variance.
+ *
+ * Usage: testdensify [seed]
+ * Writes output/densify_<mode>_<size>.txt with the
+ * sorted estimates.
+ * ***************************************************/
+
+const uint32_t K = 200;
+const uint32_t TRIALS = 2000;
+const uint32_t REPS = 9;
+
+// What a mode measured on one size, for the summary.
+struct mode_result
+{
+    string mode;
+    double var;
+    double ns;
+};
+
+template <class Dens>
+mode_result runMode(const string& mode, const vector<uint32_t>& A, const vector<uint32_t>& B,
+             double truth, uint32_t size, hash_seed seed)
+{
+    typedef k_partition<mixedtab, bin_div, Dens> sketch_type;
+
+    seed_rng seeds(seed);
+    vector<double> est(TRIALS);
+    vector<uint32_t> Ak, Bk;
+    for (uint32_t i = 0; i < TRIALS; ++i) {
+        sketch_type sketch(K, seeds.split());
+        sketch.sketch(A, Ak);
+        sketch.sketch(B, Bk);
+        est[i] = sketch.estimate(Ak, Bk);
+    }
+    double mean = 0, var = 0, mse = 0;
+    for (uint32_t i = 0; i < TRIALS; ++i)
+        mean += est[i];
+    mean /= TRIALS;
+    for (uint32_t i = 0; i < TRIALS; ++i) {
+        var += (est[i] - mean) * (est[i] - mean);
+        mse += (est[i] - truth) * (est[i] - truth);
+    }
+    var /= TRIALS - 1;
+    mse /= TRIALS;
+
+    // Time per sketch of A, so the densification of ~K - |A| bins is a
+    // large part of it.
+    const size_t n = 1000;
+    sketch_type sketch(K, seeds.split());
+    bench_result r;
+    bench_measure(r, REPS, n, false, [&]() {
+        for (size_t i = 0; i < n; ++i)
+            sketch.sketch(A, Ak);
+        return Ak[0];
+    });
+
+    cout << left << setw(11) << mode << right << setw(6) << size << setw(10) << fixed
+         << setprecision(4) << truth << setw(10) << mean << setw(12) << setprecision(6) << var
+         << setw(12) << mse << setw(12) << setprecision(1) << r.ns.median << setw(10) << r.ns.mad << endl;
+    cout.unsetf(ios_base::floatfield);
+
+    sort(est.begin(), est.end());
+    ofstream fout(("output/densify_" + mode + "_" + to_string(size) + ".txt").c_str());
+    for (uint32_t i = 0; i < TRIALS; ++i)
+        fout << est[i] << endl;
+
+    mode_result res = { mode, var, r.ns.median };
+    return res;
+}
+
+// The ratio of each other mode's time or variance to that of mode best.
+void printRatios(const vector<mode_result>& res, size_t best, bool time)
+{
+    const char* sep = "";
+    for (size_t i = 0; i < res.size(); ++i) {
+        if (i == best)
+            continue;
+        double x = time ? res[i].ns / res[best].ns : res[i].var / res[best].var;
+        cout << sep << res[i].mode << " x" << setprecision(2) << fixed << x;
+        cout.unsetf(ios_base::floatfield);
+        sep = ", ";
+    }
+}
+
+// The measured trade-off on one size: the fastest mode and the one with the
+// lowest variance, against the other modes.
+void summarize(const vector<mode_result>& res)
+{
+    size_t fast = 0, best = 0;
+    for (size_t i = 1; i < res.size(); ++i) {
+        fast = res[i].ns < res[fast].ns ? i : fast;
+        best = res[i].var < res[best].var ? i : best;
+    }
+    cout << "  fastest: " << res[fast].mode << " (";
+    printRatios(res, fast, true);
+    cout << " the time), lowest variance: " << res[best].mode << " (";
+    printRatios(res, best, false);
+    cout << " the variance)" << endl;
+}
+
+int main(int argc, char** argv)
+{
+    hash_seed seed = argc > 1 ? hash_seed(strtoull(argv[1], NULL, 10)) : random_seed();
+    cout << "Seed: " << seed.value << ", k = " << K << ", " << TRIALS << " trials" << endl;
+    cout << left << setw(11) << "mode" << right << setw(6) << "|A|" << setw(10) << "J"
+         << setw(10) << "mean" << setw(12) << "variance" << setw(12) << "mse"
+         << setw(12) << "ns/sketch" << setw(10) << "mad" << endl;
+
+    const uint32_t sizes[] = { 10, 20, 50, 100, 200 };
+    for (uint32_t size : sizes) {
+        // |A| = |B| = about size with similarity about 1/2, so the
+        // intersection is 2/3 of each set.
+        vector<uint32_t> A, B;
+        uint32_t inter = genBinarySets(A, B, 2*(size - 2*size/3), 2*size/3, 0.5);
+        double truth = (double)inter / (double)(A.size() + B.size() - inter);
+        vector<mode_result> res;
+        res.push_back(runMode<densify_leftright>("leftright", A, B, truth, A.size(), seed));
+        res.push_back(runMode<densify_optimal>("optimal", A, B, truth, A.size(), seed));
+        res.push_back(runMode<densify_fast>("fast", A, B, truth, A.size(), seed));
+        summarize(res);
+    }
+}
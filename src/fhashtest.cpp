@@ -46,7 +46,7 @@ void testNorm(uint32_t sdSize, uint32_t intSize,
     cout << "<A,B> = " << dotprod(A,B) << endl;
     cout << "<B,B> = " << dotprod(B,B) << endl;
 
-    vector<double> results_ms, results_mt, results_poly, results_poly20, results_mur;
+    vector<double> results_ms, results_mt, results_poly, results_poly20, results_mur, results_crc;
 
     // Run the trials with multiply-shift
     for (uint32_t i = 0; i < trials; ++i) {
@@ -54,19 +54,22 @@ void testNorm(uint32_t sdSize, uint32_t intSize,
         f_hash<mixedtab> s_mt(k);
         f_hash<polyhash2> s_poly(k);
         f_hash<murmurwrap> s_mur(k);
-        f_hash<polyhash> s_poly20(k,20);
+        f_hash<polyhash_k<20>> s_poly20(k);
+        f_hash<crc32hash> s_crc(k);
 
-        vector<double> A_ms, A_mt, A_p, A_p20, A_mur;
+        vector<double> A_ms, A_mt, A_p, A_p20, A_mur, A_crc;
         s_ms.sketch(A, A_ms);
         s_mt.sketch(A, A_mt);
         s_poly.sketch(A, A_p);
         s_mur.sketch(A, A_mur);
         s_poly20.sketch(A, A_p20);
+        s_crc.sketch(A, A_crc);
         results_ms.push_back(s_ms.dotprod(A_ms, A_ms));
         results_mt.push_back(s_mt.dotprod(A_mt, A_mt));
         results_poly.push_back(s_poly.dotprod(A_p, A_p));
         results_mur.push_back(s_mur.dotprod(A_mur, A_mur));
         results_poly20.push_back(s_poly20.dotprod(A_p20, A_p20));
+        results_crc.push_back(s_crc.dotprod(A_crc, A_crc));
     }
     
     sort(results_ms.begin(), results_ms.end());
@@ -74,6 +77,7 @@ void testNorm(uint32_t sdSize, uint32_t intSize,
     sort(results_poly.begin(), results_poly.end());
     sort(results_mur.begin(), results_mur.end());
     sort(results_poly20.begin(), results_poly20.end());
+    sort(results_crc.begin(), results_crc.end());
 
     // Output results
     ofstream fout;
@@ -121,6 +125,15 @@ void testNorm(uint32_t sdSize, uint32_t intSize,
     }
     fout.close();
     cout << "Average <A',A'> for Polyhash (2-indep): " << avg/(double)trials << endl;
+
+    fout.open("output/fhash_crc.txt");
+    avg = 0.0;
+    for (auto it = results_crc.begin(); it != results_crc.end(); ++it) {
+        fout << *it << endl;
+        avg += *it;
+    }
+    fout.close();
+    cout << "Average <A',A'> for CRC32C: " << avg/(double)trials << endl;
 }
 
 int main()
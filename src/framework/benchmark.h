@@ -0,0 +1,232 @@
+/* ***********************************************
+ * Micro-benchmark support:
+ * Repeats a timed run, optionally after evicting
+ * the caches, and summarizes the repetitions by
+ * median, minimum, maximum and median absolute
+ * deviation (MAD), per key.
+ *
+ * Time is measured with steady_clock, and on x86
+ * also in time stamp counter ticks. The TSC runs at
+ * the nominal frequency, so ticks equal core cycles
+ * only when the core runs at that frequency.
+ *
+ * With HASHING_PERF set, the hardware counters of
+ * perfcounters.h are also read around every timed
+ * run and reported per key.
+ *
+ * bench_report collects the results and prints
+ * them as a table or as JSON.
+ * ***********************************************/
+
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+
+#include "cpufeatures.h"
+#include "perfcounters.h"
+
+#ifdef HASHING_X86_SIMD
+#include <x86intrin.h>
+#endif
+
+// Ticks of the time stamp counter, or 0 where there is none.
+inline uint64_t bench_ticks()
+{
+#ifdef HASHING_X86_SIMD
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Read by timed loops to create dependencies the compiler cannot remove.
+static volatile uint32_t bench_zero = 0;
+static volatile uint32_t bench_sink;
+
+struct bench_stats
+{
+    double median;
+    double min;
+    double max;
+    double mad;
+};
+
+bench_stats bench_summarize(std::vector<double> v)
+{
+    bench_stats s = { 0, 0, 0, 0 };
+    if (v.empty())
+        return s;
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    s.min = v[0];
+    s.max = v[n-1];
+    s.median = (n % 2) ? v[n/2] : (v[n/2 - 1] + v[n/2]) / 2;
+    std::vector<double> dev(n);
+    for (size_t i = 0; i < n; ++i)
+        dev[i] = std::fabs(v[i] - s.median);
+    std::sort(dev.begin(), dev.end());
+    s.mad = (n % 2) ? dev[n/2] : (dev[n/2 - 1] + dev[n/2]) / 2;
+    return s;
+}
+
+// Evict the caches by reading a buffer larger than the last level cache.
+void bench_flush_caches()
+{
+    static std::vector<uint64_t> buf(64 << 17); // 64 MB
+    uint64_t s = 0;
+    for (size_t i = 0; i < buf.size(); i += 8)
+        s += buf[i]++;
+    bench_sink = (uint32_t)s;
+}
+
+struct bench_result
+{
+    std::string hasher;
+    std::string keys;   // key distribution
+    std::string mode;   // what is timed, e.g. throughput, latency, batch
+    std::string cache;  // warm or cold
+    size_t n;           // keys per repetition
+    uint32_t reps;
+    bench_stats ns;     // ns per key
+    bench_stats ticks;  // TSC ticks per key
+    perf_values perf;   // Counters per key, averaged over the repetitions
+};
+
+// Time run() reps times. run() processes n keys and returns a value that is
+// kept so the work is not optimized away. Warm runs are preceded by one
+// untimed run, cold runs by evicting the caches before each repetition.
+template <class Fn>
+void bench_measure(bench_result& r, uint32_t reps, size_t n, bool cold, Fn run)
+{
+    r.n = n;
+    r.reps = reps;
+    r.cache = cold ? "cold" : "warm";
+    if (!cold)
+        bench_sink = run();
+    perf_phases& counters = perf_phases::global();
+    perf_values total;
+    std::vector<double> ns(reps), ticks(reps);
+    for (uint32_t i = 0; i < reps; ++i) {
+        if (cold)
+            bench_flush_caches();
+        perf_values p0 = counters.read();
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        uint64_t c0 = bench_ticks();
+        bench_sink = run();
+        uint64_t c1 = bench_ticks();
+        std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+        total += counters.read() - p0;
+        ns[i] = std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+        ticks[i] = (double)(c1 - c0) / n;
+    }
+    r.ns = bench_summarize(ns);
+    r.ticks = bench_summarize(ticks);
+    for (int e = 0; e < PERF_NUM_EVENTS; ++e)
+        total.v[e] /= (double)n * reps;
+    r.perf = total;
+}
+
+class bench_report
+{
+    std::vector<bench_result> m_results;
+
+    static void json_string(std::ostream& out, const std::string& s);
+    static void json_stats(std::ostream& out, const bench_stats& s);
+
+public:
+    void add(const bench_result& r) { m_results.push_back(r); }
+    const std::vector<bench_result>& results() const { return m_results; }
+
+    static void print_header(std::ostream& out);
+    static void print_row(std::ostream& out, const bench_result& r);
+    // The results with the given settings recorded as context.
+    void write_json(std::ostream& out, const std::vector<std::pair<std::string, std::string>>& context) const;
+};
+
+void bench_report::print_header(std::ostream& out)
+{
+    out << std::left << std::setw(34) << "hasher" << std::setw(11) << "keys"
+        << std::setw(12) << "mode" << std::setw(6) << "cache" << std::right
+        << std::setw(10) << "ns/key" << std::setw(9) << "mad" << std::setw(10) << "min"
+        << std::setw(10) << "max" << std::setw(11) << "ticks/key" << std::endl;
+}
+
+void bench_report::print_row(std::ostream& out, const bench_result& r)
+{
+    out << std::left << std::setw(34) << r.hasher << std::setw(11) << r.keys
+        << std::setw(12) << r.mode << std::setw(6) << r.cache << std::right << std::fixed
+        << std::setprecision(3) << std::setw(10) << r.ns.median << std::setw(9) << r.ns.mad
+        << std::setw(10) << r.ns.min << std::setw(10) << r.ns.max
+        << std::setprecision(2) << std::setw(11) << r.ticks.median;
+    for (int e = 0; e < PERF_NUM_EVENTS; ++e)
+        if (r.perf.valid[e])
+            out << "  " << perf_event_name((perf_event_id)e) << "/key " << std::setprecision(3) << r.perf.v[e];
+    out << std::endl;
+    out.unsetf(std::ios_base::floatfield);
+}
+
+void bench_report::json_string(std::ostream& out, const std::string& s)
+{
+    out << '"';
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '"' || s[i] == '\\')
+            out << '\\';
+        out << s[i];
+    }
+    out << '"';
+}
+
+void bench_report::json_stats(std::ostream& out, const bench_stats& s)
+{
+    out << "{\"median\": " << s.median << ", \"min\": " << s.min
+        << ", \"max\": " << s.max << ", \"mad\": " << s.mad << "}";
+}
+
+void bench_report::write_json(std::ostream& out, const std::vector<std::pair<std::string, std::string>>& context) const
+{
+    std::streamsize prec = out.precision(6);
+    out << "{\n  \"context\": {";
+    for (size_t i = 0; i < context.size(); ++i) {
+        out << (i ? ", " : "");
+        json_string(out, context[i].first);
+        out << ": ";
+        json_string(out, context[i].second);
+    }
+    out << "},\n  \"results\": [";
+    for (size_t i = 0; i < m_results.size(); ++i) {
+        const bench_result& r = m_results[i];
+        out << (i ? ",\n" : "\n") << "    {\"hasher\": ";
+        json_string(out, r.hasher);
+        out << ", \"keys\": ";
+        json_string(out, r.keys);
+        out << ", \"mode\": ";
+        json_string(out, r.mode);
+        out << ", \"cache\": ";
+        json_string(out, r.cache);
+        out << ", \"n\": " << r.n << ", \"reps\": " << r.reps << ", \"ns_per_key\": ";
+        json_stats(out, r.ns);
+        out << ", \"ticks_per_key\": ";
+        json_stats(out, r.ticks);
+        bool any = false;
+        for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+            if (!r.perf.valid[e])
+                continue;
+            out << (any ? ", \"" : ", \"perf_per_key\": {\"") << perf_event_name((perf_event_id)e) << "\": " << r.perf.v[e];
+            any = true;
+        }
+        out << (any ? "}}" : "}");
+    }
+    out << "\n  ]\n}" << std::endl;
+    out.precision(prec);
+}
+
+#endif // _BENCHMARK_H_
@@ -0,0 +1,167 @@
+/* ***********************************************
+ * Bin mapping policies for the sketches:
+ * A policy maps a 32-bit hash value h to a bin in
+ * [0, k) and, for k_partition, to a rank within the
+ * bin. The rank orders the hash values of a bin and
+ * is below max/k + 1 for every policy, so the
+ * densification of k_partition is unchanged.
+ *
+ *   bin_div      bin = h % k, rank = h / k with a
+ *                precomputed reciprocal (Lemire et
+ *                al., Faster remainder by direct
+ *                computation). Same values as the
+ *                plain division. The default.
+ *   bin_mod      h % k and h / k with the division
+ *                instruction, for reference.
+ *   bin_pow2     bin = low bits, rank = high bits.
+ *                k must be a power of two.
+ *   bin_range    bin = (h*k) >> 32 (Lemire's fast
+ *                range), rank = the offset of h from
+ *                the first value of its bin, from a
+ *                table of the k bin starts.
+ *
+ * All are exact: every bin gets floor or ceil of
+ * 2^32/k hash values and the rank is a bijection
+ * of the values of a bin onto [0, bin size).
+ *
+ * split_many() splits a block of hash values, with
+ * SIMD kernels where the CPU has them.
+ * ***********************************************/
+
+#ifndef _BINMAP_H_
+#define _BINMAP_H_
+
+#include <cstdint>
+#include <vector>
+#include <stdexcept>
+
+// Batched split kernels
+#include "sketch_simd.h"
+
+class bin_mod
+{
+    uint32_t m_k;
+
+public:
+    static const char* name() { return "mod"; }
+    void init(uint32_t k) { m_k = k; }
+    uint32_t bin(uint32_t h) const { return h % m_k; }
+    uint32_t split(uint32_t h, uint32_t& rank) const
+    {
+        rank = h / m_k;
+        return h % m_k;
+    }
+    void split_many(const uint32_t* h, uint32_t* bin, uint32_t* rank, size_t n) const
+    {
+        for (size_t i = 0; i < n; ++i)
+            bin[i] = split(h[i], rank[i]);
+    }
+};
+
+class bin_div
+{
+    uint32_t m_k;
+    uint64_t m_M;      // ceil(2^64 / k), 0 for k = 1
+    uint32_t m_one;    // All ones for k = 1, where M does not fit
+
+public:
+    // Same bins and ranks as bin_mod, so sketches are interchangeable.
+    static const char* name() { return "mod"; }
+    void init(uint32_t k)
+    {
+        m_k = k;
+        m_M = UINT64_C(0xFFFFFFFFFFFFFFFF) / k + 1;
+        m_one = (k == 1) ? 0xFFFFFFFF : 0;
+    }
+    uint32_t bin(uint32_t h) const
+    {
+        uint64_t frac = m_M * h;
+        return (uint32_t)(((unsigned __int128)frac * m_k) >> 64);
+    }
+    uint32_t split(uint32_t h, uint32_t& rank) const
+    {
+        rank = (uint32_t)(((unsigned __int128)m_M * h) >> 64) + (h & m_one);
+        return h - rank * m_k;
+    }
+    void split_many(const uint32_t* h, uint32_t* bin, uint32_t* rank, size_t n) const
+    {
+        size_t i = 0;
+#ifdef HASHING_X86_SIMD
+        simd_level lvl = cpu_simd_level();
+        if (lvl == SIMD_AVX512)
+            i = bin_div_split_avx512(m_M, m_k, m_one, h, bin, rank, n);
+        else if (lvl == SIMD_AVX2)
+            i = bin_div_split_avx2(m_M, m_k, m_one, h, bin, rank, n);
+#endif
+        for (; i < n; ++i)
+            bin[i] = split(h[i], rank[i]);
+    }
+};
+
+class bin_pow2
+{
+    uint32_t m_mask;
+    uint32_t m_shift;
+
+public:
+    static const char* name() { return "pow2"; }
+    void init(uint32_t k)
+    {
+        if (k == 0 || (k & (k - 1)))
+            throw std::invalid_argument("bin_pow2 needs a power of two");
+        m_mask = k - 1;
+        m_shift = 0;
+        while ((1ULL << m_shift) < k)
+            ++m_shift;
+    }
+    uint32_t bin(uint32_t h) const { return h & m_mask; }
+    uint32_t split(uint32_t h, uint32_t& rank) const
+    {
+        rank = (uint32_t)((uint64_t)h >> m_shift);
+        return h & m_mask;
+    }
+    // The loop vectorizes on its own.
+    void split_many(const uint32_t* h, uint32_t* bin, uint32_t* rank, size_t n) const
+    {
+        for (size_t i = 0; i < n; ++i)
+            bin[i] = split(h[i], rank[i]);
+    }
+};
+
+class bin_range
+{
+    uint32_t m_k;
+    std::vector<uint32_t> m_start; // First hash value of each bin
+
+public:
+    static const char* name() { return "range"; }
+    void init(uint32_t k)
+    {
+        m_k = k;
+        m_start.resize(k);
+        for (uint32_t b = 0; b < k; ++b)
+            m_start[b] = (uint32_t)((((uint64_t)b << 32) + k - 1) / k);
+    }
+    uint32_t bin(uint32_t h) const { return (uint32_t)(((uint64_t)h * m_k) >> 32); }
+    uint32_t split(uint32_t h, uint32_t& rank) const
+    {
+        uint32_t b = bin(h);
+        rank = h - m_start[b];
+        return b;
+    }
+    void split_many(const uint32_t* h, uint32_t* bin, uint32_t* rank, size_t n) const
+    {
+        size_t i = 0;
+#ifdef HASHING_X86_SIMD
+        simd_level lvl = cpu_simd_level();
+        if (lvl == SIMD_AVX512)
+            i = bin_range_split_avx512(m_k, &m_start[0], h, bin, rank, n);
+        else if (lvl == SIMD_AVX2)
+            i = bin_range_split_avx2(m_k, &m_start[0], h, bin, rank, n);
+#endif
+        for (; i < n; ++i)
+            bin[i] = split(h[i], rank[i]);
+    }
+};
+
+#endif // _BINMAP_H_
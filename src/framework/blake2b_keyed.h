@@ -0,0 +1,276 @@
+/* ***********************************************
+ * Keyed BLAKE2b of 32-bit keys with 32-bit output:
+ * blake2b(out, 4, &x, 4, key, 32).
+ *
+ * A keyed BLAKE2b hash of a short message is two
+ * compressions: the key block and the message
+ * block. The first only depends on the key, so its
+ * result is computed once (blake2b_keyed_state) and
+ * each key costs one compression.
+ *
+ * The batch kernels run one compression per 64-bit
+ * vector lane, i.e. 4 (AVX2) or 8 (AVX-512)
+ * independent messages interleaved. Like the other
+ * kernels in hashing_simd.h they return the number
+ * of keys hashed and must only be called if
+ * cpu_simd_level() reports support.
+ * ***********************************************/
+
+#ifndef _BLAKE2B_KEYED_H_
+#define _BLAKE2B_KEYED_H_
+
+#include <cstdint>
+#include <cstddef>
+
+#include "cpufeatures.h"
+
+#ifdef HASHING_X86_SIMD
+#include <immintrin.h>
+#endif
+
+static const uint64_t blake2b_keyed_IV[8] =
+{
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+    0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+    0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+static const uint8_t blake2b_keyed_sigma[12][16] =
+{
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+    { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+    { 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+    {  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+    {  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+    {  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+    { 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+    { 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+    {  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+    { 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 },
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+    { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 }
+};
+
+// Key length in bytes and digest length in bytes
+const uint32_t blake2b_keyed_keylen = 32;
+const uint32_t blake2b_keyed_outlen = 4;
+
+// The round function with the G function given as a macro, the same for
+// all vector widths. ROUND(r) with a constant r lets the compiler drop the
+// additions of the all-zero message words.
+#define B2K_ROUND(G, r)                          \
+    do {                                         \
+        G(r, 0, v[ 0], v[ 4], v[ 8], v[12]);     \
+        G(r, 1, v[ 1], v[ 5], v[ 9], v[13]);     \
+        G(r, 2, v[ 2], v[ 6], v[10], v[14]);     \
+        G(r, 3, v[ 3], v[ 7], v[11], v[15]);     \
+        G(r, 4, v[ 0], v[ 5], v[10], v[15]);     \
+        G(r, 5, v[ 1], v[ 6], v[11], v[12]);     \
+        G(r, 6, v[ 2], v[ 7], v[ 8], v[13]);     \
+        G(r, 7, v[ 3], v[ 4], v[ 9], v[14]);     \
+    } while(0)
+
+#define B2K_ROUNDS(G)                            \
+    do {                                         \
+        B2K_ROUND(G, 0); B2K_ROUND(G, 1);        \
+        B2K_ROUND(G, 2); B2K_ROUND(G, 3);        \
+        B2K_ROUND(G, 4); B2K_ROUND(G, 5);        \
+        B2K_ROUND(G, 6); B2K_ROUND(G, 7);        \
+        B2K_ROUND(G, 8); B2K_ROUND(G, 9);        \
+        B2K_ROUND(G, 10); B2K_ROUND(G, 11);      \
+    } while(0)
+
+/* ***************************************************
+ * Scalar
+ * ***************************************************/
+
+static inline uint64_t b2k_rotr(uint64_t w, unsigned c)
+{
+    return (w >> c) | (w << (64 - c));
+}
+
+#define B2K_G_SCALAR(r, i, a, b, c, d)                   \
+    do {                                                 \
+        a = a + b + m[blake2b_keyed_sigma[r][2*i+0]];    \
+        d = b2k_rotr(d ^ a, 32);                         \
+        c = c + d;                                       \
+        b = b2k_rotr(b ^ c, 24);                         \
+        a = a + b + m[blake2b_keyed_sigma[r][2*i+1]];    \
+        d = b2k_rotr(d ^ a, 16);                         \
+        c = c + d;                                       \
+        b = b2k_rotr(b ^ c, 63);                         \
+    } while(0)
+
+// One compression of the block m into h. t0 is the byte count including
+// this block and last is set for the final block.
+static inline void blake2b_keyed_compress(uint64_t h[8], const uint64_t m[16], uint64_t t0, bool last)
+{
+    uint64_t v[16];
+    for (int i = 0; i < 8; ++i) {
+        v[i] = h[i];
+        v[i+8] = blake2b_keyed_IV[i];
+    }
+    v[12] ^= t0;
+    if (last)
+        v[14] = ~v[14];
+
+    B2K_ROUNDS(B2K_G_SCALAR);
+
+    for (int i = 0; i < 8; ++i)
+        h[i] ^= v[i] ^ v[i+8];
+}
+
+// The state after the key block.
+void blake2b_keyed_state(const uint64_t key[4], uint64_t h[8])
+{
+    // Parameter block: digest length, key length, fanout 1, depth 1
+    for (int i = 0; i < 8; ++i)
+        h[i] = blake2b_keyed_IV[i];
+    h[0] ^= 0x01010000 ^ (blake2b_keyed_keylen << 8) ^ blake2b_keyed_outlen;
+
+    // The key padded with zeros to a full block
+    uint64_t m[16] = {0};
+    for (int i = 0; i < 4; ++i)
+        m[i] = key[i];
+    blake2b_keyed_compress(h, m, 128, false);
+}
+
+// Hash one key from the state after the key block.
+uint32_t blake2b_keyed_hash(const uint64_t h[8], uint32_t x)
+{
+    uint64_t m[16] = {0};
+    m[0] = x;
+    uint64_t s[8];
+    for (int i = 0; i < 8; ++i)
+        s[i] = h[i];
+    blake2b_keyed_compress(s, m, 128 + 4, true);
+    return (uint32_t)s[0];
+}
+
+#ifdef HASHING_X86_SIMD
+
+// See hashing_simd.h: GCC 12's AVX-512 intrinsics trip -Wmaybe-uninitialized.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+/* ***************************************************
+ * AVX2: 4 messages. There is no 64-bit rotate, the
+ * byte-aligned rotations are byte shuffles.
+ * ***************************************************/
+
+__attribute__((target("avx2")))
+static inline __m256i b2k_rotr_avx2(__m256i w, int c)
+{
+    const __m256i r16 = _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,
+                                         2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+    const __m256i r24 = _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,
+                                         3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+    if (c == 32)
+        return _mm256_shuffle_epi32(w, _MM_SHUFFLE(2, 3, 0, 1));
+    if (c == 24)
+        return _mm256_shuffle_epi8(w, r24);
+    if (c == 16)
+        return _mm256_shuffle_epi8(w, r16);
+    return _mm256_or_si256(_mm256_srli_epi64(w, 63), _mm256_add_epi64(w, w)); // c == 63
+}
+
+#define B2K_G_AVX2(r, i, a, b, c, d)                                             \
+    do {                                                                         \
+        a = _mm256_add_epi64(_mm256_add_epi64(a, b), m[blake2b_keyed_sigma[r][2*i+0]]); \
+        d = b2k_rotr_avx2(_mm256_xor_si256(d, a), 32);                           \
+        c = _mm256_add_epi64(c, d);                                              \
+        b = b2k_rotr_avx2(_mm256_xor_si256(b, c), 24);                           \
+        a = _mm256_add_epi64(_mm256_add_epi64(a, b), m[blake2b_keyed_sigma[r][2*i+1]]); \
+        d = b2k_rotr_avx2(_mm256_xor_si256(d, a), 16);                           \
+        c = _mm256_add_epi64(c, d);                                              \
+        b = b2k_rotr_avx2(_mm256_xor_si256(b, c), 63);                           \
+    } while(0)
+
+__attribute__((target("avx2")))
+size_t blake2b_keyed_avx2(const uint64_t h[8], const uint32_t* in, uint32_t* out, size_t n)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i m[16];
+        for (int j = 1; j < 16; ++j)
+            m[j] = zero;
+        m[0] = _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i*)(in + i)));
+
+        __m256i v[16];
+        for (int j = 0; j < 8; ++j) {
+            v[j] = _mm256_set1_epi64x(h[j]);
+            v[j+8] = _mm256_set1_epi64x(blake2b_keyed_IV[j]);
+        }
+        v[12] = _mm256_set1_epi64x(blake2b_keyed_IV[4] ^ (128 + 4));
+        v[14] = _mm256_set1_epi64x(~blake2b_keyed_IV[6]);
+
+        B2K_ROUNDS(B2K_G_AVX2);
+
+        __m256i r = _mm256_xor_si256(_mm256_set1_epi64x(h[0]), _mm256_xor_si256(v[0], v[8]));
+        r = _mm256_permutevar8x32_epi32(r, pack);
+        _mm_storeu_si128((__m128i*)(out + i), _mm256_castsi256_si128(r));
+    }
+    return i;
+}
+
+/* ***************************************************
+ * AVX-512: 8 messages, with native rotations.
+ * ***************************************************/
+
+#define B2K_G_AVX512(r, i, a, b, c, d)                                           \
+    do {                                                                         \
+        a = _mm512_add_epi64(_mm512_add_epi64(a, b), m[blake2b_keyed_sigma[r][2*i+0]]); \
+        d = _mm512_ror_epi64(_mm512_xor_si512(d, a), 32);                        \
+        c = _mm512_add_epi64(c, d);                                              \
+        b = _mm512_ror_epi64(_mm512_xor_si512(b, c), 24);                        \
+        a = _mm512_add_epi64(_mm512_add_epi64(a, b), m[blake2b_keyed_sigma[r][2*i+1]]); \
+        d = _mm512_ror_epi64(_mm512_xor_si512(d, a), 16);                        \
+        c = _mm512_add_epi64(c, d);                                              \
+        b = _mm512_ror_epi64(_mm512_xor_si512(b, c), 63);                        \
+    } while(0)
+
+__attribute__((target("avx512f")))
+size_t blake2b_keyed_avx512(const uint64_t h[8], const uint32_t* in, uint32_t* out, size_t n)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i m[16];
+        for (int j = 1; j < 16; ++j)
+            m[j] = zero;
+        m[0] = _mm512_cvtepu32_epi64(_mm256_loadu_si256((const __m256i*)(in + i)));
+
+        __m512i v[16];
+        for (int j = 0; j < 8; ++j) {
+            v[j] = _mm512_set1_epi64(h[j]);
+            v[j+8] = _mm512_set1_epi64(blake2b_keyed_IV[j]);
+        }
+        v[12] = _mm512_set1_epi64(blake2b_keyed_IV[4] ^ (128 + 4));
+        v[14] = _mm512_set1_epi64(~blake2b_keyed_IV[6]);
+
+        B2K_ROUNDS(B2K_G_AVX512);
+
+        __m512i r = _mm512_xor_si512(_mm512_set1_epi64(h[0]), _mm512_xor_si512(v[0], v[8]));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm512_cvtepi64_epi32(r));
+    }
+    return i;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // HASHING_X86_SIMD
+
+#undef B2K_G_SCALAR
+#undef B2K_G_AVX2
+#undef B2K_G_AVX512
+#undef B2K_ROUND
+#undef B2K_ROUNDS
+
+#endif // _BLAKE2B_KEYED_H_
@@ -0,0 +1,20 @@
+// The CRC variants of CityHash (CityHashCrc128, CityHashCrc128WithSeed and
+// CityHashCrc256) need SSE4.2. This file builds them from city.cc with
+// -msse4.2, while city.cc itself is built without it, so the plain CityHash
+// functions run on every x86-64 CPU. The plain functions compiled here are
+// renamed so they do not clash with those of city.cc; only the CRC functions
+// call them. citycrcwrap checks that the CPU has SSE4.2 before calling the
+// CRC functions.
+
+#ifndef __SSE4_2__
+#error "citycrc_sse42.cc must be compiled with -msse4.2"
+#endif
+
+#define CityHash32 CityHashSse42_32
+#define CityHash64 CityHashSse42_64
+#define CityHash64WithSeed CityHashSse42_64WithSeed
+#define CityHash64WithSeeds CityHashSse42_64WithSeeds
+#define CityHash128 CityHashSse42_128
+#define CityHash128WithSeed CityHashSse42_128WithSeed
+
+#include "city.cc"
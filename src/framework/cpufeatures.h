@@ -0,0 +1,107 @@
+/* ***********************************************
+ * Runtime CPU feature detection:
+ * Decides which SIMD kernels the batched hash
+ * functions may use on the machine we run on. The
+ * binary itself is built without -march so it runs
+ * everywhere.
+ *
+ * Each batched function checks cpu_simd_level() and
+ * calls the kernel for that level, which is compiled
+ * for its target with a function attribute (see
+ * hashing_simd.h). The level is fixed at the first
+ * call and can be lowered with the environment
+ * variable HASHING_SIMD for A/B comparisons.
+ * ***********************************************/
+
+#ifndef _CPUFEATURES_H_
+#define _CPUFEATURES_H_
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HASHING_X86_SIMD
+#endif
+
+// For batched loops of dependent table lookups. Without gathers the loop
+// vectorizer emulates them through the stack, which is slower than the
+// scalar lookups.
+#if defined(__GNUC__) && !defined(__clang__)
+#define HASHING_NO_VECTORIZE __attribute__((optimize("no-tree-vectorize")))
+#else
+#define HASHING_NO_VECTORIZE
+#endif
+
+enum simd_level
+{
+    SIMD_SCALAR = 0,
+    SIMD_SSE42 = 1,
+    SIMD_AVX2 = 2,
+    SIMD_AVX512 = 3
+};
+
+const char* simd_level_name(simd_level lvl)
+{
+    static const char* names[] = { "scalar", "sse4.2", "avx2", "avx512" };
+    return names[lvl];
+}
+
+// The level named by the environment variable HASHING_SIMD, or -1 if it is
+// not set. Unknown names are reported and ignored.
+int simd_level_from_env()
+{
+    const char* s = getenv("HASHING_SIMD");
+    if (!s || !*s)
+        return -1;
+    for (int i = SIMD_SCALAR; i <= SIMD_AVX512; ++i)
+        if (strcmp(s, simd_level_name((simd_level)i)) == 0)
+            return i;
+    if (strcmp(s, "sse42") == 0)
+        return SIMD_SSE42;
+    std::cerr << "HASHING_SIMD: unknown level " << s
+              << " (use scalar, sse4.2, avx2 or avx512)" << std::endl;
+    return -1;
+}
+
+// The widest usable extension of the CPU, ignoring HASHING_SIMD.
+simd_level cpu_detect_simd_level()
+{
+#ifdef HASHING_X86_SIMD
+    return __builtin_cpu_supports("avx512f") ? SIMD_AVX512 :
+           __builtin_cpu_supports("avx2") ? SIMD_AVX2 :
+           __builtin_cpu_supports("sse4.2") ? SIMD_SSE42 : SIMD_SCALAR;
+#else
+    return SIMD_SCALAR;
+#endif
+}
+
+// The level all hash functions and sketches dispatch on. It is decided once,
+// at the first call: the widest extension the CPU supports, lowered to the
+// level in HASHING_SIMD if that is set, e.g.
+//     HASHING_SIMD=scalar ./testtime
+// to compare against the scalar code with the same binary. A level above
+// what the CPU supports is never used.
+simd_level cpu_simd_level()
+{
+    static const simd_level level = []() {
+        simd_level lvl = cpu_detect_simd_level();
+        int req = simd_level_from_env();
+        return (req >= 0 && req < lvl) ? (simd_level)req : lvl;
+    }();
+    return level;
+}
+
+// The crc32 instruction. The AVX levels imply it on all x86 CPUs, but it is
+// checked separately anyway.
+bool cpu_has_sse42()
+{
+#ifdef HASHING_X86_SIMD
+    static const bool has = cpu_simd_level() >= SIMD_SSE42 && __builtin_cpu_supports("sse4.2");
+    return has;
+#else
+    return false;
+#endif
+}
+
+#endif // _CPUFEATURES_H_
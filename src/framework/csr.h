@@ -0,0 +1,44 @@
+/* ***********************************************
+ * A collection of sets in compressed sparse row
+ * (CSR) form: the elements of all sets in one array,
+ * set i being elements[offsets[i], offsets[i+1]).
+ * The batch sketching functions take the sets of a
+ * corpus in this form, so no set is a separate
+ * allocation.
+ *
+ * The element type is the key type for k_partition
+ * and bottom_k and an (index, value)-pair for
+ * f_hash.
+ * ***********************************************/
+
+#ifndef _CSR_H_
+#define _CSR_H_
+
+#include <cstddef>
+#include <vector>
+
+template <class T>
+struct csr_sets
+{
+    std::vector<size_t> offsets; // size() + 1 entries, starting with 0
+    std::vector<T> elements;
+
+    csr_sets() : offsets(1, 0) { }
+
+    size_t size() const { return offsets.size() - 1; }
+    const T* set(size_t i) const { return elements.data() + offsets[i]; }
+    size_t set_size(size_t i) const { return offsets[i+1] - offsets[i]; }
+
+    void push_back(const std::vector<T>& s)
+    {
+        elements.insert(elements.end(), s.begin(), s.end());
+        offsets.push_back(elements.size());
+    }
+    void clear()
+    {
+        offsets.assign(1, 0);
+        elements.clear();
+    }
+};
+
+#endif // _CSR_H_
@@ -0,0 +1,345 @@
+/* ***********************************************
+ * Densification policies for k_partition:
+ * A bin that no key hashed to holds max and is
+ * filled with the value of a non-empty bin, offset
+ * by a multiple of thr = max/k + 1. For hash
+ * functions of one output bin values are below
+ * thr, so a filled bin never equals a real value.
+ * With several outputs the values are full 32-bit
+ * ranks below max (see k_partition), and a filled
+ * bin equals a real value of the other sketch with
+ * probability about 2^-32. The policies record
+ * which bins were empty instead of comparing with
+ * thr, so they work for both.
+ *
+ *   densify_leftright  Shrivastava and Li, Improved
+ *                      densification of one
+ *                      permutation hashing. A random
+ *                      bit per bin picks the nearest
+ *                      non-empty bin to the left or
+ *                      right, the value is offset by
+ *                      the distance. Three passes over
+ *                      the sketch, O(k). The default,
+ *                      and the fastest on sparse sets.
+ *   densify_optimal    Shrivastava, Optimal
+ *                      densification for fast and
+ *                      accurate minwise hashing. Bin i
+ *                      probes the bins given by a
+ *                      hash of (i, attempt) until it
+ *                      finds a non-empty one. The
+ *                      copies of different empty bins
+ *                      are independent, so the
+ *                      variance on sparse sets is the
+ *                      lowest. An empty bin takes k/m
+ *                      probes for m non-empty bins,
+ *                      so O(k^2/m) in total: much
+ *                      slower than leftright on
+ *                      sparse sets.
+ *   densify_fast       Mai et al., On densification
+ *                      for minwise hashing, for a
+ *                      fixed number of rounds: in
+ *                      round t every non-empty bin j
+ *                      fills the bin given by a hash
+ *                      of (j, t) if it is still empty.
+ *                      Bins still empty after 8 rounds
+ *                      copy the first non-empty or
+ *                      filled bin after a hashed bin.
+ *                      At most 8m probes and three
+ *                      passes, O(k). On sparse sets
+ *                      much faster than optimal, with
+ *                      a variance close to it; slower
+ *                      than leftright, most so on
+ *                      dense sets.
+ *
+ * testdensify measures the variance and time of the
+ * three on sparse sets.
+ *
+ * The probe order depends only on the seed, so two
+ * sets sketched with the same sketch agree in an
+ * empty bin exactly when the first bin in that
+ * order that is non-empty for their union holds
+ * the same minimum in both, and the estimate stays
+ * unbiased.
+ * ***********************************************/
+
+#ifndef _DENSIFY_H_
+#define _DENSIFY_H_
+
+#include <cstdint>
+#include <vector>
+#include <limits>
+
+#include "seeding.h"
+#include "state.h"
+
+// The probe hash of the hash-based policies: the sum a_i*i + a_t*t + b of
+// vector multiply-shift (Thorup, High speed hashing for integers and
+// strings) with 64-bit a_i, a_t and b, mixed and reduced to a bin. The sum
+// for t+1 is that of t plus a_t, so a probe sequence costs an add and a
+// multiply per probe.
+struct densify_hash
+{
+    uint64_t a_i, a_t, b;
+
+    void init(seed_rng& rng)
+    {
+        a_i = rng();
+        a_t = rng();
+        b = rng();
+    }
+    void save(state_writer& out) const
+    {
+        out.put(a_i);
+        out.put(a_t);
+        out.put(b);
+    }
+    void load(state_reader& in)
+    {
+        in.get(a_i);
+        in.get(a_t);
+        in.get(b);
+    }
+    // The sum for probe 0 of i.
+    uint64_t start(uint32_t i) const { return a_i * i + b; }
+    // The bin in [0, k) of a sum. The sums of round t+1 are those of round
+    // t shifted by a_t, so one xorshift-multiply step breaks up the pattern.
+    static uint32_t bin(uint64_t sum, uint32_t k)
+    {
+        uint64_t z = (sum ^ (sum >> 29)) * 0xBF58476D1CE4E5B9ULL;
+        return (uint32_t)(((z >> 32) * k) >> 32);
+    }
+};
+
+// Scratch space of k words for densifying one sketch. It is on the stack
+// for k up to m_local_size, so sketching many sets does not allocate.
+class densify_scratch
+{
+    static const uint32_t m_local_size = 1024;
+    uint32_t m_local[m_local_size];
+    std::vector<uint32_t> m_heap;
+    uint32_t* m_p;
+
+public:
+    explicit densify_scratch(uint32_t k) : m_p(m_local)
+    {
+        if (k > m_local_size) {
+            m_heap.resize(k);
+            m_p = &m_heap[0];
+        }
+    }
+    uint32_t& operator[](uint32_t i) { return m_p[i]; }
+};
+
+class densify_leftright
+{
+    std::vector<uint32_t> m_copy; // 0: copy from the left, 1: from the right
+
+public:
+    static const char* name() { return "leftright"; }
+    void init(uint32_t k, seed_rng& rng);
+    void save(state_writer& out) const;
+    void load(state_reader& in, uint32_t k);
+    void densify(uint32_t* output, uint32_t k) const;
+};
+
+// Draw the bits 64 at a time.
+void densify_leftright::init(uint32_t k, seed_rng& rng)
+{
+    m_copy.assign(k, 0);
+    uint64_t bits = 0;
+    for (uint32_t i = 0; i < k; ++i, bits >>= 1) {
+        if (i % 64 == 0)
+            bits = rng();
+        m_copy[i] = bits & 1;
+    }
+}
+
+void densify_leftright::save(state_writer& out) const
+{
+    out.put(&m_copy[0], m_copy.size()*sizeof(uint32_t));
+}
+
+void densify_leftright::load(state_reader& in, uint32_t k)
+{
+    if (k > in.remaining()/sizeof(uint32_t))
+        throw state_error("bad densification size");
+    m_copy.resize(k);
+    in.get(&m_copy[0], k*sizeof(uint32_t));
+}
+
+void densify_leftright::densify(uint32_t* output, uint32_t k) const
+{
+    uint32_t thr = std::numeric_limits<uint32_t>::max() / k + 1;
+    const uint32_t empty = std::numeric_limits<uint32_t>::max();
+
+    // full[i] tells whether bin i was non-empty. The first pass fills bins,
+    // and filled values are only told apart by value for narrow ranks.
+    densify_scratch full(k);
+    uint32_t m = 0;
+    for (uint32_t i = 0; i < k; ++i) {
+        full[i] = output[i] != empty;
+        m += full[i];
+    }
+    if (m == 0 || m == k)
+        return;
+
+    // Both are set by the scans below, as some bin is non-empty.
+    uint32_t sl = 0, sr = 0;
+    uint32_t jl = 0, jr = 0;
+    for (int i = (int)k-1; i >= 0; --i) {
+        ++jl;
+        if (full[i]) {
+            sl = output[i];
+            break;
+        }
+    }
+    for (int i = 0; i < (int)k; ++i) {
+        ++jr;
+        if (full[i]) {
+            sr = output[i];
+            break;
+        }
+    }
+
+    // The random bits make branches unpredictable, so the passes select.
+    for (int i = 0; i < (int)k; ++i) {
+        uint32_t v = output[i];
+        bool e = !full[i];
+        jl = e ? jl + 1 : 0;
+        sl = e ? sl : v;
+        output[i] = (e && m_copy[i] == 0) ? sl + jl*thr : v;
+    }
+    for (int i = (int)k-1; i >= 0; --i) {
+        uint32_t v = output[i];
+        bool e = !full[i];
+        jr = e ? jr + 1 : 0;
+        sr = e ? sr : v;
+        output[i] = (e && m_copy[i] == 1) ? sr + jr*thr : v;
+    }
+}
+
+class densify_optimal
+{
+    densify_hash m_hash;
+
+    // Probes per bin before falling back to a scan to the right. With m
+    // non-empty bins a probe misses with probability 1 - m/k, so the
+    // fallback is taken with probability below e^-64.
+    static const uint32_t m_probes_per_bin = 64;
+
+public:
+    static const char* name() { return "optimal"; }
+    void init(uint32_t, seed_rng& rng) { m_hash.init(rng); }
+    void save(state_writer& out) const { m_hash.save(out); }
+    void load(state_reader& in, uint32_t) { m_hash.load(in); }
+    void densify(uint32_t* output, uint32_t k) const;
+};
+
+void densify_optimal::densify(uint32_t* output, uint32_t k) const
+{
+    uint32_t thr = std::numeric_limits<uint32_t>::max() / k + 1;
+    const uint32_t empty = std::numeric_limits<uint32_t>::max();
+
+    // full[j] tells whether bin j was non-empty; bins filled before it
+    // are probed too.
+    densify_scratch full(k);
+    uint32_t m = 0;
+    for (uint32_t i = 0; i < k; ++i) {
+        full[i] = output[i] != empty;
+        m += full[i];
+    }
+    if (m == 0 || m == k)
+        return;
+
+    uint64_t limit = (uint64_t)m_probes_per_bin * k;
+    for (uint32_t i = 0; i < k; ++i) {
+        if (full[i])
+            continue;
+        uint32_t j = i;
+        bool found = false;
+        uint64_t sum = m_hash.start(i);
+        for (uint64_t t = 0; t < limit && !found; ++t, sum += m_hash.a_t) {
+            j = densify_hash::bin(sum, k);
+            found = full[j];
+        }
+        while (!found) {
+            j = (j + 1 == k) ? 0 : j + 1;
+            found = full[j];
+        }
+        output[i] = output[j] + thr;
+    }
+}
+
+class densify_fast
+{
+    densify_hash m_hash;
+
+    // Rounds before the bins still empty fall back to the scan, at most
+    // m_rounds * k probes in total. It must not depend on the set: a subset
+    // given more rounds would fill bins that its superset leaves to the
+    // scan, and the estimate would be biased. After 8 rounds a bin is still
+    // empty with probability about e^(-8m/k).
+    static const uint32_t m_rounds = 8;
+
+public:
+    static const char* name() { return "fast"; }
+    void init(uint32_t, seed_rng& rng) { m_hash.init(rng); }
+    void save(state_writer& out) const { m_hash.save(out); }
+    void load(state_reader& in, uint32_t) { m_hash.load(in); }
+    void densify(uint32_t* output, uint32_t k) const;
+};
+
+void densify_fast::densify(uint32_t* output, uint32_t k) const
+{
+    uint32_t thr = std::numeric_limits<uint32_t>::max() / k + 1;
+    const uint32_t empty = std::numeric_limits<uint32_t>::max();
+
+    // state[i] is 0 for an empty bin, 1 for a non-empty one and 2 for a
+    // filled one. bins holds the non-empty bins, in order.
+    densify_scratch state(k), bins(k);
+    uint32_t m = 0;
+    for (uint32_t i = 0; i < k; ++i) {
+        state[i] = output[i] != empty;
+        bins[m] = i;
+        m += state[i];
+    }
+    if (m == 0 || m == k)
+        return;
+
+    // In round t every non-empty bin j fills the bin given by a hash of
+    // (j, t) if it is still empty.
+    uint32_t left = k - m;
+    for (uint32_t t = 0; t < m_rounds && left > 0; ++t) {
+        uint64_t step = m_hash.a_t * t;
+        for (uint32_t n = 0; n < m; ++n) {
+            uint32_t j = bins[n];
+            uint32_t i = densify_hash::bin(m_hash.start(j) + step, k);
+            if (state[i] == 0) {
+                output[i] = output[j] + thr;
+                state[i] = 2;
+                --left;
+            }
+        }
+    }
+    if (left == 0)
+        return;
+
+    // next[i] is the first bin at or after i, cyclically, that is non-empty
+    // or filled. A bin still empty copies next[] of a hashed bin.
+    densify_scratch& next = bins;
+    uint32_t j = 0;
+    while (state[j] == 0)
+        ++j;
+    for (uint32_t i = k; i-- > 0; ) {
+        j = state[i] != 0 ? i : j;
+        next[i] = j;
+    }
+    for (uint32_t i = 0; i < k; ++i) {
+        if (state[i] != 0)
+            continue;
+        uint32_t q = next[densify_hash::bin(m_hash.start(i), k)];
+        output[i] = state[q] == 1 ? output[q] + thr : output[q];
+    }
+}
+
+#endif // _DENSIFY_H_
@@ -5,6 +5,11 @@
  *
  * If DEBUG is defined it asserts that initialization
  * is done properly.
+ *
+ * init() draws a fresh seed, init(hash_seed) gives a
+ * deterministic hash function for the seed.
+ * save() and load() store the full state, see
+ * state.h.
  * ***********************************************/
 
 #ifndef _HASHING_H_
@@ -12,14 +17,23 @@
 
 #include <vector>
 #include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include <array>
+#include <string>
 
 #ifdef DEBUG
 #include <cassert>
 #endif
 
-// TODO: If you have a seed of random bytes (from e.g. random.org) you can use
-// the randomgen file instead to provide random numbers.
-#include <random>  // TODO: Replace with: #include "randomgen.h"
+#include "hashing_simd.h"
+#include "tabtable.h"
+
+// Hash functions initialized without a seed draw one with random_seed(). See
+// seeding.h on how to use a seed of random bytes instead.
+#include "seeding.h"
+// save() and load() of the tables and coefficients
+#include "state.h"
 
 /* ***********************************************
  * Multiply-shift hashing a la Dietzfelbinger
@@ -32,9 +46,14 @@ class multishift
     uint64_t m_a, m_b;
 
 public:
+    typedef uint32_t key_type;
     multishift();
-    uint32_t operator()(uint32_t x);
+    uint32_t operator()(uint32_t x) const;
+    void hash_many(const uint32_t* in, uint32_t* out, size_t n) const;
     void init();
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
 };
 
 multishift::multishift()
@@ -46,20 +65,37 @@ multishift::multishift()
 
 void multishift::init()
 {
-    std::mt19937 rng;
-    rng.seed(std::random_device()());
-    std::uniform_int_distribution<uint64_t> dist;
-    m_a = dist(rng);
-    m_b = dist(rng);
-    // TODO: Replace with the lines below if using randomgen.h
-    //m_a = getRandomUInt64();
-    //m_b = getRandomUInt64();
+    init(random_seed());
+}
+
+void multishift::init(hash_seed seed)
+{
+    seed_rng rng(seed);
+    m_a = rng();
+    m_b = rng();
+#ifdef DEBUG
+    hasInit=true;
+#endif
+}
+
+void multishift::save(state_writer& out) const
+{
+    out.tag("multishift");
+    out.put(m_a);
+    out.put(m_b);
+}
+
+void multishift::load(state_reader& in)
+{
+    in.tag("multishift");
+    in.get(m_a);
+    in.get(m_b);
 #ifdef DEBUG
     hasInit=true;
 #endif
 }
 
-uint32_t multishift::operator()(uint32_t x)
+uint32_t multishift::operator()(uint32_t x) const
 {
 #ifdef DEBUG
     assert(hasInit);
@@ -67,6 +103,126 @@ uint32_t multishift::operator()(uint32_t x)
     return (m_a * (uint64_t)x + m_b) >> 32;
 }
 
+// Hash n keys at once. Uses the widest SIMD kernel the CPU supports and
+// otherwise processes four independent keys per iteration so the
+// multiplications can overlap in the pipeline.
+void multishift::hash_many(const uint32_t* in, uint32_t* out, size_t n) const
+{
+#ifdef DEBUG
+    assert(hasInit);
+#endif
+    size_t i = 0;
+#ifdef HASHING_X86_SIMD
+    simd_level lvl = cpu_simd_level();
+    if (lvl == SIMD_AVX512)
+        i = multishift_avx512(m_a, m_b, in, out, n);
+    else if (lvl == SIMD_AVX2)
+        i = multishift_avx2(m_a, m_b, in, out, n);
+#endif
+    for (; i + 4 <= n; i += 4) {
+        uint64_t h0 = m_a * (uint64_t)in[i] + m_b;
+        uint64_t h1 = m_a * (uint64_t)in[i+1] + m_b;
+        uint64_t h2 = m_a * (uint64_t)in[i+2] + m_b;
+        uint64_t h3 = m_a * (uint64_t)in[i+3] + m_b;
+        out[i] = h0 >> 32;
+        out[i+1] = h1 >> 32;
+        out[i+2] = h2 >> 32;
+        out[i+3] = h3 >> 32;
+    }
+    for (; i < n; ++i)
+        out[i] = (m_a * (uint64_t)in[i] + m_b) >> 32;
+}
+
+/* ***********************************************
+ * Multiply-shift hashing of 64-bit keys. Strongly
+ * universal with 128-bit a, b (Dietzfelbinger '96):
+ * the top 32 bits of a*x + b mod 2^128.
+ * ***********************************************/
+class multishift64
+{
+#ifdef DEBUG
+    bool hasInit;
+#endif
+    unsigned __int128 m_a, m_b;
+
+public:
+    typedef uint64_t key_type;
+    multishift64();
+    uint32_t operator()(uint64_t x) const;
+    void hash_many(const uint64_t* in, uint32_t* out, size_t n) const;
+    void init();
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+};
+
+multishift64::multishift64()
+{
+#ifdef DEBUG
+    hasInit=false;
+#endif
+}
+
+void multishift64::init()
+{
+    init(random_seed());
+}
+
+void multishift64::init(hash_seed seed)
+{
+    seed_rng rng(seed);
+    m_a = ((unsigned __int128)rng() << 64) | rng();
+    m_b = ((unsigned __int128)rng() << 64) | rng();
+#ifdef DEBUG
+    hasInit=true;
+#endif
+}
+
+void multishift64::save(state_writer& out) const
+{
+    out.tag("multishift64");
+    out.put(m_a);
+    out.put(m_b);
+}
+
+void multishift64::load(state_reader& in)
+{
+    in.tag("multishift64");
+    in.get(m_a);
+    in.get(m_b);
+#ifdef DEBUG
+    hasInit=true;
+#endif
+}
+
+uint32_t multishift64::operator()(uint64_t x) const
+{
+#ifdef DEBUG
+    assert(hasInit);
+#endif
+    return (uint32_t)((m_a * x + m_b) >> 96);
+}
+
+void multishift64::hash_many(const uint64_t* in, uint32_t* out, size_t n) const
+{
+#ifdef DEBUG
+    assert(hasInit);
+#endif
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        unsigned __int128 h0 = m_a * in[i] + m_b;
+        unsigned __int128 h1 = m_a * in[i+1] + m_b;
+        unsigned __int128 h2 = m_a * in[i+2] + m_b;
+        unsigned __int128 h3 = m_a * in[i+3] + m_b;
+        out[i] = (uint32_t)(h0 >> 96);
+        out[i+1] = (uint32_t)(h1 >> 96);
+        out[i+2] = (uint32_t)(h2 >> 96);
+        out[i+3] = (uint32_t)(h3 >> 96);
+    }
+    for (; i < n; ++i)
+        out[i] = (*this)(in[i]);
+}
+
 /* ***************************************************
  * Poly hashing with 3-independence. Specialized
  * ***************************************************/
@@ -81,9 +237,14 @@ class polyhash3
     const uint64_t m_p = 2305843009213693951;
 
 public:
+    typedef uint32_t key_type;
     polyhash3();
     void init(); 
-    uint32_t operator()(uint32_t x);
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(uint32_t x) const;
+    void hash_many(const uint32_t* in, uint32_t* out, size_t n) const;
 };
 
 polyhash3::polyhash3()
@@ -95,19 +256,40 @@ polyhash3::polyhash3()
 
 void polyhash3::init()
 {
-    std::mt19937 rng;
-    rng.seed(std::random_device()());
-    std::uniform_int_distribution<uint64_t> dist;
-    m_a = dist(rng);
-    m_b = dist(rng);
-    m_c = dist(rng);
-    // TODO: Replace with the lines below if using randomgen.h
-    //m_a = getRandomUInt64();
-    //m_b = getRandomUInt64();
-    //m_c = getRandomUInt64();
+    init(random_seed());
+}
+
+void polyhash3::init(hash_seed seed)
+{
+    seed_rng rng(seed);
+    m_a = rng();
+    m_b = rng();
+    m_c = rng();
+#ifdef DEBUG
+    hasInit=true;
+#endif
+}
+
+void polyhash3::save(state_writer& out) const
+{
+    out.tag("polyhash3");
+    out.put(m_a);
+    out.put(m_b);
+    out.put(m_c);
+}
+
+void polyhash3::load(state_reader& in)
+{
+    in.tag("polyhash3");
+    in.get(m_a);
+    in.get(m_b);
+    in.get(m_c);
+#ifdef DEBUG
+    hasInit=true;
+#endif
 }
 
-uint32_t polyhash3::operator()(uint32_t x)
+uint32_t polyhash3::operator()(uint32_t x) const
 {
 #ifdef DEBUG
     assert(hasInit);
@@ -120,6 +302,46 @@ uint32_t polyhash3::operator()(uint32_t x)
     return (uint32_t)h;
 }
 
+void polyhash3::hash_many(const uint32_t* in, uint32_t* out, size_t n) const
+{
+#ifdef DEBUG
+    assert(hasInit);
+#endif
+    size_t i = 0;
+#ifdef HASHING_X86_SIMD
+    simd_level lvl = cpu_simd_level();
+    if (lvl == SIMD_AVX512)
+        i = polyhash3_avx512(m_a, m_b, m_c, in, out, n);
+    else if (lvl == SIMD_AVX2)
+        i = polyhash3_avx2(m_a, m_b, m_c, in, out, n);
+#endif
+    for (; i + 4 <= n; i += 4) {
+        uint32_t x0 = in[i], x1 = in[i+1], x2 = in[i+2], x3 = in[i+3];
+        __int128 h0 = m_a * x0 + m_b;
+        __int128 h1 = m_a * x1 + m_b;
+        __int128 h2 = m_a * x2 + m_b;
+        __int128 h3 = m_a * x3 + m_b;
+        h0 = (h0 & m_p) + (h0 >> 61);
+        h1 = (h1 & m_p) + (h1 >> 61);
+        h2 = (h2 & m_p) + (h2 >> 61);
+        h3 = (h3 & m_p) + (h3 >> 61);
+        h0 = h0*x0 + m_c;
+        h1 = h1*x1 + m_c;
+        h2 = h2*x2 + m_c;
+        h3 = h3*x3 + m_c;
+        h0 = (h0 & m_p) + (h0 >> 61);
+        h1 = (h1 & m_p) + (h1 >> 61);
+        h2 = (h2 & m_p) + (h2 >> 61);
+        h3 = (h3 & m_p) + (h3 >> 61);
+        out[i] = (uint32_t)((h0 & m_p) + (h0 >> 61));
+        out[i+1] = (uint32_t)((h1 & m_p) + (h1 >> 61));
+        out[i+2] = (uint32_t)((h2 & m_p) + (h2 >> 61));
+        out[i+3] = (uint32_t)((h3 & m_p) + (h3 >> 61));
+    }
+    for (; i < n; ++i)
+        out[i] = (*this)(in[i]);
+}
+
 
 /* ***************************************************
  * Poly hashing with 2-independence. Specialized
@@ -135,9 +357,14 @@ class polyhash2
     const uint64_t m_p = 2305843009213693951;
 
 public:
+    typedef uint32_t key_type;
     polyhash2();
     void init(); 
-    uint32_t operator()(uint32_t x);
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(uint32_t x) const;
+    void hash_many(const uint32_t* in, uint32_t* out, size_t n) const;
 };
 
 polyhash2::polyhash2()
@@ -149,17 +376,37 @@ polyhash2::polyhash2()
 
 void polyhash2::init()
 {
-    std::mt19937 rng;
-    rng.seed(std::random_device()());
-    std::uniform_int_distribution<uint64_t> dist;
-    m_a = dist(rng);
-    m_b = dist(rng);
-    // TODO: Replace with below lines if using randomgen.h
-    //m_a = getRandomUInt64();
-    //m_b = getRandomUInt64();
+    init(random_seed());
 }
 
-uint32_t polyhash2::operator()(uint32_t x)
+void polyhash2::init(hash_seed seed)
+{
+    seed_rng rng(seed);
+    m_a = rng();
+    m_b = rng();
+#ifdef DEBUG
+    hasInit=true;
+#endif
+}
+
+void polyhash2::save(state_writer& out) const
+{
+    out.tag("polyhash2");
+    out.put(m_a);
+    out.put(m_b);
+}
+
+void polyhash2::load(state_reader& in)
+{
+    in.tag("polyhash2");
+    in.get(m_a);
+    in.get(m_b);
+#ifdef DEBUG
+    hasInit=true;
+#endif
+}
+
+uint32_t polyhash2::operator()(uint32_t x) const
 {
 #ifdef DEBUG
     assert(hasInit);
@@ -170,6 +417,37 @@ uint32_t polyhash2::operator()(uint32_t x)
     return (uint32_t)h;
 }
 
+void polyhash2::hash_many(const uint32_t* in, uint32_t* out, size_t n) const
+{
+#ifdef DEBUG
+    assert(hasInit);
+#endif
+    size_t i = 0;
+#ifdef HASHING_X86_SIMD
+    simd_level lvl = cpu_simd_level();
+    if (lvl == SIMD_AVX512)
+        i = polyhash2_avx512(m_a, m_b, in, out, n);
+    else if (lvl == SIMD_AVX2)
+        i = polyhash2_avx2(m_a, m_b, in, out, n);
+#endif
+    for (; i + 4 <= n; i += 4) {
+        __int128 h0 = m_a * in[i] + m_b;
+        __int128 h1 = m_a * in[i+1] + m_b;
+        __int128 h2 = m_a * in[i+2] + m_b;
+        __int128 h3 = m_a * in[i+3] + m_b;
+        h0 = (h0 & m_p) + (h0 >> 61);
+        h1 = (h1 & m_p) + (h1 >> 61);
+        h2 = (h2 & m_p) + (h2 >> 61);
+        h3 = (h3 & m_p) + (h3 >> 61);
+        out[i] = (uint32_t)((h0 & m_p) + (h0 >> 61));
+        out[i+1] = (uint32_t)((h1 & m_p) + (h1 >> 61));
+        out[i+2] = (uint32_t)((h2 & m_p) + (h2 >> 61));
+        out[i+3] = (uint32_t)((h3 & m_p) + (h3 >> 61));
+    }
+    for (; i < n; ++i)
+        out[i] = (*this)(in[i]);
+}
+
 
 
 /* ***************************************************
@@ -187,10 +465,16 @@ class polyhash
     const uint64_t m_p = 2305843009213693951;
 
 public:
+    typedef uint32_t key_type;
     polyhash();
     void init(); // 2-indep
     void init(uint32_t deg);
-    uint32_t operator()(uint32_t x);
+    void init(hash_seed seed); // 2-indep
+    void init(uint32_t deg, hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(uint32_t x) const;
+    void hash_many(const uint32_t* in, uint32_t* out, size_t n) const;
 };
 
 polyhash::polyhash()
@@ -207,18 +491,22 @@ void polyhash::init()
 
 void polyhash::init(uint32_t deg)
 {
-    // TODO: Remove the following 3 lines if using randomgen.h
-    std::mt19937 rng;
-    rng.seed(std::random_device()());
-    std::uniform_int_distribution<uint64_t> dist;
+    init(deg, random_seed());
+}
+
+void polyhash::init(hash_seed seed)
+{
+    init(2, seed);
+}
 
+void polyhash::init(uint32_t deg, hash_seed seed)
+{
+    seed_rng rng(seed);
     m_deg = deg;
     m_coef.resize(m_deg,0);
     for (uint32_t i = 0; i < m_deg; ++i) {
 		do {
-            // TODO: Swap the two lines below if using randomgen.h
-			//m_coef[i] = getRandomUInt64() >> 3;
-			m_coef[i] = (dist(rng)) >> 3;
+			m_coef[i] = rng() >> 3;
 #ifdef DEBUG
 			assert(m_coef[i] <= m_p); //Since poly_p = 2^61-1.
 #endif
@@ -229,7 +517,30 @@ void polyhash::init(uint32_t deg)
 #endif
 }
 
-uint32_t polyhash::operator()(uint32_t x)
+void polyhash::save(state_writer& out) const
+{
+    out.tag("polyhash");
+    out.put(m_deg);
+    out.put(&m_coef[0], m_deg*sizeof(uint64_t));
+}
+
+void polyhash::load(state_reader& in)
+{
+    in.tag("polyhash");
+    in.get(m_deg);
+    if (m_deg == 0 || m_deg > in.remaining()/sizeof(uint64_t))
+        throw state_error("bad polyhash degree");
+    m_coef.resize(m_deg);
+    in.get(&m_coef[0], m_deg*sizeof(uint64_t));
+    for (uint32_t i = 0; i < m_deg; ++i)
+        if (m_coef[i] >= m_p)
+            throw state_error("bad polyhash coefficient");
+#ifdef DEBUG
+    hasInit=true;
+#endif
+}
+
+uint32_t polyhash::operator()(uint32_t x) const
 {
 #ifdef DEBUG
     assert(hasInit);
@@ -243,6 +554,161 @@ uint32_t polyhash::operator()(uint32_t x)
     return (uint32_t)h;
 }
 
+// Evaluate the polynomial for four keys in lockstep. The Horner steps of the
+// four keys are independent, which hides the latency of the 128-bit multiply.
+void polyhash::hash_many(const uint32_t* in, uint32_t* out, size_t n) const
+{
+#ifdef DEBUG
+    assert(hasInit);
+#endif
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint32_t x0 = in[i], x1 = in[i+1], x2 = in[i+2], x3 = in[i+3];
+        __int128 h0 = 0, h1 = 0, h2 = 0, h3 = 0;
+        for (int32_t j = m_deg-1; j >= 0; --j) {
+            uint64_t c = m_coef[j];
+            h0 = h0 * x0 + c;
+            h1 = h1 * x1 + c;
+            h2 = h2 * x2 + c;
+            h3 = h3 * x3 + c;
+            h0 = (h0 & m_p) + (h0 >> 61);
+            h1 = (h1 & m_p) + (h1 >> 61);
+            h2 = (h2 & m_p) + (h2 >> 61);
+            h3 = (h3 & m_p) + (h3 >> 61);
+        }
+        out[i] = (uint32_t)((h0 & m_p) + (h0 >> 61));
+        out[i+1] = (uint32_t)((h1 & m_p) + (h1 >> 61));
+        out[i+2] = (uint32_t)((h2 & m_p) + (h2 >> 61));
+        out[i+3] = (uint32_t)((h3 & m_p) + (h3 >> 61));
+    }
+    for (; i < n; ++i)
+        out[i] = (*this)(in[i]);
+}
+
+/* ***************************************************
+ * Poly hashing with the degree fixed at compile time.
+ * Same function as polyhash::init(Degree), but the
+ * coefficients are stored inline and the Horner loop
+ * is unrolled. The tabulation tables are not filled
+ * with it but directly from seed_rng, see seeding.h.
+ * ***************************************************/
+
+template <uint32_t Degree>
+class polyhash_k
+{
+    static_assert(Degree >= 1, "degree must be positive");
+#ifdef DEBUG
+    bool hasInit;
+#endif
+    std::array<uint64_t, Degree> m_coef;
+    // Large mersenne prime (2^61 - 1)
+    static const uint64_t m_p = 2305843009213693951;
+    // Keys evaluated in lockstep by hash_many
+    static const uint32_t lanes = 4;
+
+public:
+    typedef uint32_t key_type;
+    polyhash_k();
+    void init();
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(uint32_t x) const;
+    void hash_many(const uint32_t* in, uint32_t* out, size_t n) const;
+};
+
+template <uint32_t Degree>
+polyhash_k<Degree>::polyhash_k()
+{
+#ifdef DEBUG
+    hasInit=false;
+#endif
+}
+
+template <uint32_t Degree>
+void polyhash_k<Degree>::init()
+{
+    init(random_seed());
+}
+
+template <uint32_t Degree>
+void polyhash_k<Degree>::init(hash_seed seed)
+{
+    seed_rng rng(seed);
+    for (uint32_t i = 0; i < Degree; ++i) {
+        do {
+            m_coef[i] = rng() >> 3;
+        } while(m_coef[i] >= m_p);
+    }
+#ifdef DEBUG
+    hasInit=true;
+#endif
+}
+
+template <uint32_t Degree>
+void polyhash_k<Degree>::save(state_writer& out) const
+{
+    out.tag("polyhash_k<" + std::to_string(Degree) + ">");
+    out.put(&m_coef[0], Degree*sizeof(uint64_t));
+}
+
+template <uint32_t Degree>
+void polyhash_k<Degree>::load(state_reader& in)
+{
+    in.tag("polyhash_k<" + std::to_string(Degree) + ">");
+    in.get(&m_coef[0], Degree*sizeof(uint64_t));
+    for (uint32_t i = 0; i < Degree; ++i)
+        if (m_coef[i] >= m_p)
+            throw state_error("bad polyhash_k coefficient");
+#ifdef DEBUG
+    hasInit=true;
+#endif
+}
+
+template <uint32_t Degree>
+uint32_t polyhash_k<Degree>::operator()(uint32_t x) const
+{
+#ifdef DEBUG
+    assert(hasInit);
+#endif
+    __int128 h = 0;
+#pragma GCC unroll 32
+    for (int32_t i = Degree-1; i >= 0; --i) {
+        h = h * x + m_coef[i];
+        h = (h & m_p) + (h >> 61);
+    }
+    h = (h & m_p) + (h >> 61);
+    return (uint32_t)h;
+}
+
+// Each Horner step waits for a 128-bit multiply. Evaluating several keys in
+// lockstep gives the CPU independent multiplies to overlap.
+template <uint32_t Degree>
+void polyhash_k<Degree>::hash_many(const uint32_t* in, uint32_t* out, size_t n) const
+{
+#ifdef DEBUG
+    assert(hasInit);
+#endif
+    size_t i = 0;
+    for (; i + lanes <= n; i += lanes) {
+        __int128 h[lanes];
+        for (uint32_t l = 0; l < lanes; ++l)
+            h[l] = 0;
+#pragma GCC unroll 32
+        for (int32_t j = Degree-1; j >= 0; --j) {
+            uint64_t c = m_coef[j];
+            for (uint32_t l = 0; l < lanes; ++l) {
+                h[l] = h[l] * in[i+l] + c;
+                h[l] = (h[l] & m_p) + (h[l] >> 61);
+            }
+        }
+        for (uint32_t l = 0; l < lanes; ++l)
+            out[i+l] = (uint32_t)((h[l] & m_p) + (h[l] >> 61));
+    }
+    for (; i < n; ++i)
+        out[i] = (*this)(in[i]);
+}
+
 /* ***************************************************
  * Mixed Tabulation a la Dahlgaard et al.
  * ***************************************************/
@@ -252,15 +718,20 @@ class mixedtab
 #ifdef DEBUG
     bool hasInit;
 #endif
-    // Use 4 characters + 4 derived characters.
-    // TODO: Parameterize
+    // Use 4 characters + 4 derived characters. Other sizes are
+    // mixedtab_t below.
     uint64_t mt_T1[256][4];
     uint32_t mt_T2[256][4];
 
 public:
+    typedef uint32_t key_type;
     mixedtab();
     void init();
-    uint32_t operator()(uint32_t x);
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(uint32_t x) const;
+    void hash_many(const uint32_t* in, uint32_t* out, size_t n) const;
 };
 
 mixedtab::mixedtab()
@@ -272,25 +743,38 @@ mixedtab::mixedtab()
 
 void mixedtab::init()
 {
-    // Use a degree-20 polynomial to fill out the entries.
-    polyhash h;
-    h.init(20);
-
-	uint32_t x = 0;
-    for (int i = 0; i < 4; ++i) {
-        for (int j = 0; j < 256; ++j) {
-            mt_T1[j][i] = h(x++);
-            mt_T1[j][i] <<= 32;
-            mt_T1[j][i] += h(x++);
-            mt_T2[j][i] = h(x++);
-        }
-    }
+    init(random_seed());
+}
+
+void mixedtab::init(hash_seed seed)
+{
+    // Fill the tables directly from the generator.
+    seed_rng rng(seed);
+    rng.fill(&mt_T1[0][0], 256*4);
+    rng.fill(&mt_T2[0][0], 256*4);
+#ifdef DEBUG
+    hasInit = true;
+#endif
+}
+
+void mixedtab::save(state_writer& out) const
+{
+    out.tag("mixedtab");
+    out.put(mt_T1);
+    out.put(mt_T2);
+}
+
+void mixedtab::load(state_reader& in)
+{
+    in.tag("mixedtab");
+    in.get(mt_T1);
+    in.get(mt_T2);
 #ifdef DEBUG
     hasInit = true;
 #endif
 }
 
-uint32_t mixedtab::operator()(uint32_t x)
+uint32_t mixedtab::operator()(uint32_t x) const
 {
 #ifdef DEBUG
     assert(hasInit);
@@ -304,6 +788,565 @@ uint32_t mixedtab::operator()(uint32_t x)
     return (uint32_t)h;
 }
 
+// The lookups of one key form a dependency chain through the derived
+// characters. With AVX2/AVX-512 whole vectors of keys are looked up with
+// gathers, otherwise four keys are interleaved to keep several loads in
+// flight.
+void mixedtab::hash_many(const uint32_t* in, uint32_t* out, size_t n) const
+{
+#ifdef DEBUG
+    assert(hasInit);
+#endif
+    size_t i = 0;
+#ifdef HASHING_X86_SIMD
+    simd_level lvl = cpu_simd_level();
+    if (lvl == SIMD_AVX512)
+        i = mixedtab_avx512(&mt_T1[0][0], &mt_T2[0][0], in, out, n);
+    else if (lvl == SIMD_AVX2)
+        i = mixedtab_avx2(&mt_T1[0][0], &mt_T2[0][0], in, out, n);
+#endif
+    for (; i + 4 <= n; i += 4) {
+        uint32_t x0 = in[i], x1 = in[i+1], x2 = in[i+2], x3 = in[i+3];
+        uint64_t h0 = 0, h1 = 0, h2 = 0, h3 = 0;
+        for (int j = 0; j < 4; ++j, x0 >>= 8, x1 >>= 8, x2 >>= 8, x3 >>= 8) {
+            h0 ^= mt_T1[(uint8_t)x0][j];
+            h1 ^= mt_T1[(uint8_t)x1][j];
+            h2 ^= mt_T1[(uint8_t)x2][j];
+            h3 ^= mt_T1[(uint8_t)x3][j];
+        }
+        uint32_t d0 = h0 >> 32, d1 = h1 >> 32, d2 = h2 >> 32, d3 = h3 >> 32;
+        for (int j = 0; j < 4; ++j, d0 >>= 8, d1 >>= 8, d2 >>= 8, d3 >>= 8) {
+            h0 ^= mt_T2[(uint8_t)d0][j];
+            h1 ^= mt_T2[(uint8_t)d1][j];
+            h2 ^= mt_T2[(uint8_t)d2][j];
+            h3 ^= mt_T2[(uint8_t)d3][j];
+        }
+        out[i] = (uint32_t)h0;
+        out[i+1] = (uint32_t)h1;
+        out[i+2] = (uint32_t)h2;
+        out[i+3] = (uint32_t)h3;
+    }
+    for (; i < n; ++i)
+        out[i] = (*this)(in[i]);
+}
+
+
+/* ***************************************************
+ * Mixed Tabulation with a configurable key length,
+ * character width and number of derived characters.
+ * Larger characters mean fewer lookups per key but
+ * tables that no longer fit in L1/L2.
+ *
+ * The table layout and allocation can be chosen as
+ * well, see tabtable.h.
+ *
+ * mixedtab above is the same scheme as
+ * mixedtab_t<32, 8, 4> with hand-written batch paths.
+ * ***************************************************/
+
+template <uint32_t KeyBits> struct tab_key;
+template <> struct tab_key<32> { typedef uint32_t type; };
+template <> struct tab_key<64> { typedef uint64_t type; };
+
+template <uint32_t KeyBits, uint32_t CharBits, uint32_t DerivedChars,
+         tab_layout Layout = TAB_POSITION_MAJOR, tab_alloc Alloc = TAB_ALLOC_ALIGNED>
+class mixedtab_t
+{
+    static_assert(CharBits >= 1 && CharBits <= 16, "characters must be 1-16 bits");
+    static_assert(DerivedChars >= 1 && DerivedChars*CharBits <= 64,
+            "derived characters must fit in 64 bits");
+
+#ifdef DEBUG
+    bool hasInit;
+#endif
+    // A T1 entry holds the 32-bit hash value in its low word and the derived
+    // characters above it. Use 128-bit entries if they do not fit in 64 bits.
+    typedef typename std::conditional<32 + DerivedChars*CharBits <= 64,
+            uint64_t, unsigned __int128>::type entry_type;
+
+public:
+    typedef typename tab_key<KeyBits>::type key_type;
+    static const uint32_t chars = (KeyBits + CharBits - 1) / CharBits;
+    static const uint32_t derived = DerivedChars;
+    static const uint32_t table_len = 1u << CharBits;
+    // Total size of T1 and T2 in bytes
+    static const size_t table_bytes =
+        chars*table_len*sizeof(entry_type) + derived*table_len*sizeof(uint32_t);
+
+private:
+    static const uint32_t char_mask = table_len - 1;
+    static const uint32_t entry_words = (32 + DerivedChars*CharBits + 31) / 32;
+
+    // The tables live on the heap as 16-bit characters give tables of
+    // several MB.
+    tab_table<entry_type, chars, table_len, Layout, Alloc> m_T1;
+    tab_table<uint32_t, DerivedChars, table_len, Layout, Alloc> m_T2;
+
+public:
+    mixedtab_t();
+    void init();
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(key_type x) const;
+    void hash_many(const key_type* in, uint32_t* out, size_t n) const;
+};
+
+template <uint32_t K, uint32_t C, uint32_t D, tab_layout L, tab_alloc A>
+const uint32_t mixedtab_t<K,C,D,L,A>::chars;
+template <uint32_t K, uint32_t C, uint32_t D, tab_layout L, tab_alloc A>
+const uint32_t mixedtab_t<K,C,D,L,A>::derived;
+template <uint32_t K, uint32_t C, uint32_t D, tab_layout L, tab_alloc A>
+const uint32_t mixedtab_t<K,C,D,L,A>::table_len;
+template <uint32_t K, uint32_t C, uint32_t D, tab_layout L, tab_alloc A>
+const size_t mixedtab_t<K,C,D,L,A>::table_bytes;
+
+template <uint32_t K, uint32_t C, uint32_t D, tab_layout L, tab_alloc A>
+mixedtab_t<K,C,D,L,A>::mixedtab_t()
+{
+#ifdef DEBUG
+    hasInit = false;
+#endif
+}
+
+template <uint32_t K, uint32_t C, uint32_t D, tab_layout L, tab_alloc A>
+void mixedtab_t<K,C,D,L,A>::init()
+{
+    init(random_seed());
+}
+
+template <uint32_t K, uint32_t C, uint32_t D, tab_layout L, tab_alloc A>
+void mixedtab_t<K,C,D,L,A>::init(hash_seed seed)
+{
+    // Fill the tables directly from the generator. Bits of a T1 entry above
+    // the derived characters are never used.
+    seed_rng rng(seed);
+    rng.fill((uint64_t*)m_T1.data(), m_T1.bytes / sizeof(uint64_t));
+    rng.fill(m_T2.data(), m_T2.entries);
+#ifdef DEBUG
+    hasInit = true;
+#endif
+}
+
+// All loop bounds are compile-time constants, so the compiler unrolls them.
+// The state does not depend on the layout, so tables can be saved with one
+// layout and loaded with another.
+template <uint32_t K, uint32_t C, uint32_t D, tab_layout L, tab_alloc A>
+void mixedtab_t<K,C,D,L,A>::save(state_writer& out) const
+{
+    out.tag("mixedtab_t<" + std::to_string(K) + "," + std::to_string(C) + "," + std::to_string(D) + ">");
+    for (uint32_t pos = 0; pos < chars; ++pos)
+        for (uint32_t c = 0; c < table_len; ++c)
+            out.put(m_T1(pos, c));
+    for (uint32_t pos = 0; pos < derived; ++pos)
+        for (uint32_t c = 0; c < table_len; ++c)
+            out.put(m_T2(pos, c));
+}
+
+template <uint32_t K, uint32_t C, uint32_t D, tab_layout L, tab_alloc A>
+void mixedtab_t<K,C,D,L,A>::load(state_reader& in)
+{
+    in.tag("mixedtab_t<" + std::to_string(K) + "," + std::to_string(C) + "," + std::to_string(D) + ">");
+    for (uint32_t pos = 0; pos < chars; ++pos)
+        for (uint32_t c = 0; c < table_len; ++c)
+            in.get(m_T1(pos, c));
+    for (uint32_t pos = 0; pos < derived; ++pos)
+        for (uint32_t c = 0; c < table_len; ++c)
+            in.get(m_T2(pos, c));
+#ifdef DEBUG
+    hasInit = true;
+#endif
+}
+
+template <uint32_t K, uint32_t C, uint32_t D, tab_layout L, tab_alloc A>
+uint32_t mixedtab_t<K,C,D,L,A>::operator()(key_type x) const
+{
+#ifdef DEBUG
+    assert(hasInit);
+#endif
+    entry_type h = 0;
+    for (uint32_t i = 0; i < chars; ++i, x >>= C)
+        h ^= m_T1(i, x & char_mask);
+    uint32_t res = (uint32_t)h;
+    uint64_t drv = (uint64_t)(h >> 32);
+    for (uint32_t i = 0; i < D; ++i, drv >>= C)
+        res ^= m_T2(i, drv & char_mask);
+    return res;
+}
+
+template <uint32_t K, uint32_t C, uint32_t D, tab_layout L, tab_alloc A>
+void mixedtab_t<K,C,D,L,A>::hash_many(const key_type* in, uint32_t* out, size_t n) const
+{
+#ifdef DEBUG
+    assert(hasInit);
+#endif
+    size_t i = 0;
+    size_t m = n - n % 4;
+    for (; i < m; i += 4) {
+        key_type x0 = in[i], x1 = in[i+1], x2 = in[i+2], x3 = in[i+3];
+        entry_type h0 = 0, h1 = 0, h2 = 0, h3 = 0;
+        for (uint32_t j = 0; j < chars; ++j, x0 >>= C, x1 >>= C, x2 >>= C, x3 >>= C) {
+            h0 ^= m_T1(j, x0 & char_mask);
+            h1 ^= m_T1(j, x1 & char_mask);
+            h2 ^= m_T1(j, x2 & char_mask);
+            h3 ^= m_T1(j, x3 & char_mask);
+        }
+        uint32_t r0 = (uint32_t)h0, r1 = (uint32_t)h1, r2 = (uint32_t)h2, r3 = (uint32_t)h3;
+        uint64_t d0 = (uint64_t)(h0 >> 32), d1 = (uint64_t)(h1 >> 32);
+        uint64_t d2 = (uint64_t)(h2 >> 32), d3 = (uint64_t)(h3 >> 32);
+        for (uint32_t j = 0; j < D; ++j, d0 >>= C, d1 >>= C, d2 >>= C, d3 >>= C) {
+            r0 ^= m_T2(j, d0 & char_mask);
+            r1 ^= m_T2(j, d1 & char_mask);
+            r2 ^= m_T2(j, d2 & char_mask);
+            r3 ^= m_T2(j, d3 & char_mask);
+        }
+        out[i] = r0;
+        out[i+1] = r1;
+        out[i+2] = r2;
+        out[i+3] = r3;
+    }
+    for (; i < n; ++i)
+        out[i] = (*this)(in[i]);
+}
+
+// Presets: mixedtab<key bits>_<char bits>_<derived chars>
+typedef mixedtab_t<32, 8, 1> mixedtab32_8_1;
+typedef mixedtab_t<32, 8, 2> mixedtab32_8_2;
+typedef mixedtab_t<32, 8, 4> mixedtab32_8_4;
+typedef mixedtab_t<32, 11, 2> mixedtab32_11_2;
+typedef mixedtab_t<32, 11, 3> mixedtab32_11_3;
+typedef mixedtab_t<32, 16, 1> mixedtab32_16_1;
+typedef mixedtab_t<32, 16, 2> mixedtab32_16_2;
+typedef mixedtab_t<64, 8, 4> mixedtab64_8_4;
+typedef mixedtab_t<64, 11, 3> mixedtab64_11_3;
+typedef mixedtab_t<64, 11, 4> mixedtab64_11_4;
+typedef mixedtab_t<64, 16, 2> mixedtab64_16_2;
+typedef mixedtab_t<64, 16, 4> mixedtab64_16_4;
+// The 64-bit counterpart of mixedtab
+typedef mixedtab64_8_4 mixedtab64;
+
+
+/* ***************************************************
+ * Tornado Tabulation a la Bercea et al. (FOCS'23)
+ * The key is split into 8-bit characters. The last
+ * character is twisted with the simple tabulation of
+ * the others, then DerivedChars characters are made,
+ * each one the simple tabulation of all characters
+ * before it. The hash value is the simple tabulation
+ * of the full derived key.
+ *
+ * One lookup per character, and the low byte of the
+ * running XOR is consumed as the next character, so
+ * all tables share one sequence of lookups:
+ *     h ^= T[i][c]; c = low byte of h; h >>= 8;
+ * With 3 derived characters entries are 64 bits.
+ * ***************************************************/
+
+template <uint32_t KeyBits, uint32_t DerivedChars,
+         tab_layout Layout = TAB_POSITION_MAJOR, tab_alloc Alloc = TAB_ALLOC_ALIGNED>
+class tornadotab_t
+{
+    static_assert(DerivedChars >= 1 && DerivedChars <= 11, "1-11 derived characters");
+
+#ifdef DEBUG
+    bool hasInit;
+#endif
+    // An entry holds the twist character, the derived characters and the
+    // 32-bit hash value.
+    typedef typename std::conditional<40 + 8*DerivedChars <= 64,
+            uint64_t, unsigned __int128>::type entry_type;
+
+public:
+    typedef typename tab_key<KeyBits>::type key_type;
+    static const uint32_t chars = KeyBits / 8;
+    static const uint32_t derived = DerivedChars;
+    static const size_t table_bytes = (chars + derived) * 256 * sizeof(entry_type);
+
+private:
+    tab_table<entry_type, chars + DerivedChars, 256, Layout, Alloc> m_T;
+
+public:
+    tornadotab_t();
+    void init();
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(key_type x) const;
+    void hash_many(const key_type* in, uint32_t* out, size_t n) const HASHING_NO_VECTORIZE;
+};
+
+template <uint32_t K, uint32_t D, tab_layout L, tab_alloc A>
+const uint32_t tornadotab_t<K,D,L,A>::chars;
+template <uint32_t K, uint32_t D, tab_layout L, tab_alloc A>
+const uint32_t tornadotab_t<K,D,L,A>::derived;
+template <uint32_t K, uint32_t D, tab_layout L, tab_alloc A>
+const size_t tornadotab_t<K,D,L,A>::table_bytes;
+
+template <uint32_t K, uint32_t D, tab_layout L, tab_alloc A>
+tornadotab_t<K,D,L,A>::tornadotab_t()
+{
+#ifdef DEBUG
+    hasInit = false;
+#endif
+}
+
+template <uint32_t K, uint32_t D, tab_layout L, tab_alloc A>
+void tornadotab_t<K,D,L,A>::init()
+{
+    init(random_seed());
+}
+
+template <uint32_t K, uint32_t D, tab_layout L, tab_alloc A>
+void tornadotab_t<K,D,L,A>::init(hash_seed seed)
+{
+    seed_rng rng(seed);
+    rng.fill((uint64_t*)m_T.data(), m_T.bytes / sizeof(uint64_t));
+#ifdef DEBUG
+    hasInit = true;
+#endif
+}
+
+template <uint32_t K, uint32_t D, tab_layout L, tab_alloc A>
+void tornadotab_t<K,D,L,A>::save(state_writer& out) const
+{
+    out.tag("tornadotab_t<" + std::to_string(K) + "," + std::to_string(D) + ">");
+    for (uint32_t pos = 0; pos < chars + D; ++pos)
+        for (uint32_t c = 0; c < 256; ++c)
+            out.put(m_T(pos, c));
+}
+
+template <uint32_t K, uint32_t D, tab_layout L, tab_alloc A>
+void tornadotab_t<K,D,L,A>::load(state_reader& in)
+{
+    in.tag("tornadotab_t<" + std::to_string(K) + "," + std::to_string(D) + ">");
+    for (uint32_t pos = 0; pos < chars + D; ++pos)
+        for (uint32_t c = 0; c < 256; ++c)
+            in.get(m_T(pos, c));
+#ifdef DEBUG
+    hasInit = true;
+#endif
+}
+
+template <uint32_t K, uint32_t D, tab_layout L, tab_alloc A>
+uint32_t tornadotab_t<K,D,L,A>::operator()(key_type x) const
+{
+#ifdef DEBUG
+    assert(hasInit);
+#endif
+    entry_type h = 0;
+    for (uint32_t i = 0; i < chars - 1; ++i, x >>= 8)
+        h ^= m_T(i, (uint8_t)x);
+    // Twist the last character
+    h ^= m_T(chars - 1, (uint8_t)(x ^ h));
+    h >>= 8;
+    for (uint32_t i = 0; i < D; ++i) {
+        uint8_t c = (uint8_t)h;
+        h >>= 8;
+        h ^= m_T(chars + i, c);
+    }
+    return (uint32_t)h;
+}
+
+template <uint32_t K, uint32_t D, tab_layout L, tab_alloc A>
+void tornadotab_t<K,D,L,A>::hash_many(const key_type* in, uint32_t* out, size_t n) const
+{
+#ifdef DEBUG
+    assert(hasInit);
+#endif
+    size_t i = 0;
+    size_t m = n - n % 4;
+    for (; i < m; i += 4) {
+        key_type x0 = in[i], x1 = in[i+1], x2 = in[i+2], x3 = in[i+3];
+        entry_type h0 = 0, h1 = 0, h2 = 0, h3 = 0;
+        for (uint32_t j = 0; j < chars - 1; ++j, x0 >>= 8, x1 >>= 8, x2 >>= 8, x3 >>= 8) {
+            h0 ^= m_T(j, (uint8_t)x0);
+            h1 ^= m_T(j, (uint8_t)x1);
+            h2 ^= m_T(j, (uint8_t)x2);
+            h3 ^= m_T(j, (uint8_t)x3);
+        }
+        h0 ^= m_T(chars - 1, (uint8_t)(x0 ^ h0));
+        h1 ^= m_T(chars - 1, (uint8_t)(x1 ^ h1));
+        h2 ^= m_T(chars - 1, (uint8_t)(x2 ^ h2));
+        h3 ^= m_T(chars - 1, (uint8_t)(x3 ^ h3));
+        h0 >>= 8; h1 >>= 8; h2 >>= 8; h3 >>= 8;
+        for (uint32_t j = 0; j < D; ++j) {
+            uint8_t c0 = (uint8_t)h0, c1 = (uint8_t)h1, c2 = (uint8_t)h2, c3 = (uint8_t)h3;
+            h0 = (h0 >> 8) ^ m_T(chars + j, c0);
+            h1 = (h1 >> 8) ^ m_T(chars + j, c1);
+            h2 = (h2 >> 8) ^ m_T(chars + j, c2);
+            h3 = (h3 >> 8) ^ m_T(chars + j, c3);
+        }
+        out[i] = (uint32_t)h0;
+        out[i+1] = (uint32_t)h1;
+        out[i+2] = (uint32_t)h2;
+        out[i+3] = (uint32_t)h3;
+    }
+    for (; i < n; ++i)
+        out[i] = (*this)(in[i]);
+}
+
+typedef tornadotab_t<32, 3> tornadotab;
+typedef tornadotab_t<64, 3> tornadotab64;
+
+
+/* ***************************************************
+ * Wide-output Mixed Tabulation:
+ * Table entries are 128 or 256 bits wide, so one
+ * lookup pass gives Words-1 hash values of 32 bits.
+ * The last word of a T1 entry holds the 4 derived
+ * characters. operator() and hash_many return the
+ * first value only so the class can replace any
+ * other hash function.
+ * ***************************************************/
+
+template <uint32_t Words>
+class mixedtab_wide
+{
+    static_assert(Words == 4 || Words == 8, "entries must be 128 or 256 bits");
+#ifdef DEBUG
+    bool hasInit;
+#endif
+    struct entry { uint32_t w[Words]; };
+    // Position-major: m_T1[position][character]
+    entry m_T1[4][256];
+    entry m_T2[4][256];
+
+    void eval(uint32_t x, uint32_t* acc) const;
+
+public:
+    typedef uint32_t key_type;
+    static const uint32_t outputs = Words - 1;
+
+    mixedtab_wide();
+    void init();
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(uint32_t x) const;
+    void hash_many(const uint32_t* in, uint32_t* out, size_t n) const;
+    // All outputs: out[j] for j < outputs
+    void hash_wide(uint32_t x, uint32_t* out) const;
+    // All outputs for n keys, row-major: out[i*outputs + j]
+    void hash_many_wide(const uint32_t* in, uint32_t* out, size_t n) const;
+};
+
+template <uint32_t Words> const uint32_t mixedtab_wide<Words>::outputs;
+
+typedef mixedtab_wide<4> mixedtab128;
+typedef mixedtab_wide<8> mixedtab256;
+
+template <uint32_t Words>
+mixedtab_wide<Words>::mixedtab_wide()
+{
+#ifdef DEBUG
+    hasInit = false;
+#endif
+}
+
+template <uint32_t Words>
+void mixedtab_wide<Words>::init()
+{
+    init(random_seed());
+}
+
+template <uint32_t Words>
+void mixedtab_wide<Words>::init(hash_seed seed)
+{
+    // Fill the tables directly from the generator. The last word of the T2
+    // entries is never used.
+    seed_rng rng(seed);
+    rng.fill(m_T1[0][0].w, 4*256*Words);
+    rng.fill(m_T2[0][0].w, 4*256*Words);
+#ifdef DEBUG
+    hasInit = true;
+#endif
+}
+
+// Evaluate all words of the hash value into acc. The XOR of whole entries
+// compiles to vector instructions.
+template <uint32_t Words>
+inline void mixedtab_wide<Words>::eval(uint32_t x, uint32_t* acc) const
+{
+#ifdef DEBUG
+    assert(hasInit);
+#endif
+    for (uint32_t w = 0; w < Words; ++w)
+        acc[w] = 0;
+    for (int i = 0; i < 4; ++i, x >>= 8) {
+        const uint32_t* e = m_T1[i][(uint8_t)x].w;
+        for (uint32_t w = 0; w < Words; ++w)
+            acc[w] ^= e[w];
+    }
+    uint32_t drv = acc[outputs];
+    for (int i = 0; i < 4; ++i, drv >>= 8) {
+        const uint32_t* e = m_T2[i][(uint8_t)drv].w;
+        for (uint32_t w = 0; w < outputs; ++w)
+            acc[w] ^= e[w];
+    }
+}
+
+template <uint32_t Words>
+void mixedtab_wide<Words>::save(state_writer& out) const
+{
+    out.tag("mixedtab_wide<" + std::to_string(Words) + ">");
+    out.put(m_T1);
+    out.put(m_T2);
+}
+
+template <uint32_t Words>
+void mixedtab_wide<Words>::load(state_reader& in)
+{
+    in.tag("mixedtab_wide<" + std::to_string(Words) + ">");
+    in.get(m_T1);
+    in.get(m_T2);
+#ifdef DEBUG
+    hasInit = true;
+#endif
+}
+
+template <uint32_t Words>
+uint32_t mixedtab_wide<Words>::operator()(uint32_t x) const
+{
+    uint32_t acc[Words];
+    eval(x, acc);
+    return acc[0];
+}
+
+template <uint32_t Words>
+void mixedtab_wide<Words>::hash_many(const uint32_t* in, uint32_t* out, size_t n) const
+{
+    uint32_t acc[Words];
+    for (size_t i = 0; i < n; ++i) {
+        eval(in[i], acc);
+        out[i] = acc[0];
+    }
+}
+
+template <uint32_t Words>
+void mixedtab_wide<Words>::hash_wide(uint32_t x, uint32_t* out) const
+{
+    uint32_t acc[Words];
+    eval(x, acc);
+    for (uint32_t w = 0; w < outputs; ++w)
+        out[w] = acc[w];
+}
+
+template <uint32_t Words>
+void mixedtab_wide<Words>::hash_many_wide(const uint32_t* in, uint32_t* out, size_t n) const
+{
+    uint32_t acc[Words];
+    for (size_t i = 0; i < n; ++i, out += outputs) {
+        eval(in[i], acc);
+        for (uint32_t w = 0; w < outputs; ++w)
+            out[w] = acc[w];
+    }
+}
+
+// Number of independent 32-bit hash values a hash function gives per key.
+// Hash functions with more than one provide hash_many_wide.
+template <class F> struct hash_outputs { static const uint32_t value = 1; };
+template <uint32_t W> struct hash_outputs<mixedtab_wide<W>> { static const uint32_t value = W - 1; };
+
 
 /* ***************************************************
  * Simple Tabulation
@@ -314,9 +1357,14 @@ class simpletab
     uint32_t m_T[256][4];
 
 public:
+    typedef uint32_t key_type;
     simpletab();
     void init();
-    uint32_t operator()(uint32_t x);
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(uint32_t x) const;
+    void hash_many(const uint32_t* in, uint32_t* out, size_t n) const;
 };
 
 simpletab::simpletab()
@@ -325,17 +1373,28 @@ simpletab::simpletab()
 
 void simpletab::init()
 {
-    // Use a degree-20 polynomial to fill out the entries.
-    polyhash h;
-    h.init(20);
+    init(random_seed());
+}
+
+void simpletab::init(hash_seed seed)
+{
+    seed_rng rng(seed);
+    rng.fill(&m_T[0][0], 256*4);
+}
 
-	uint32_t x = 0;
-    for (int i = 0; i < 4; ++i)
-        for (int j = 0; j < 256; ++j)
-            m_T[j][i] = h(x++);
+void simpletab::save(state_writer& out) const
+{
+    out.tag("simpletab");
+    out.put(m_T);
 }
 
-uint32_t simpletab::operator()(uint32_t x)
+void simpletab::load(state_reader& in)
+{
+    in.tag("simpletab");
+    in.get(m_T);
+}
+
+uint32_t simpletab::operator()(uint32_t x) const
 {
     uint32_t h=0; // Final hash value
     for (int i = 0; i < 4; ++i, x >>= 8)
@@ -343,6 +1402,109 @@ uint32_t simpletab::operator()(uint32_t x)
     return h;
 }
 
+void simpletab::hash_many(const uint32_t* in, uint32_t* out, size_t n) const
+{
+    size_t i = 0;
+#ifdef HASHING_X86_SIMD
+    simd_level lvl = cpu_simd_level();
+    if (lvl == SIMD_AVX512)
+        i = simpletab_avx512(&m_T[0][0], in, out, n);
+    else if (lvl == SIMD_AVX2)
+        i = simpletab_avx2(&m_T[0][0], in, out, n);
+#endif
+    for (; i + 4 <= n; i += 4) {
+        uint32_t x0 = in[i], x1 = in[i+1], x2 = in[i+2], x3 = in[i+3];
+        uint32_t h0 = 0, h1 = 0, h2 = 0, h3 = 0;
+        for (int j = 0; j < 4; ++j, x0 >>= 8, x1 >>= 8, x2 >>= 8, x3 >>= 8) {
+            h0 ^= m_T[(uint8_t)x0][j];
+            h1 ^= m_T[(uint8_t)x1][j];
+            h2 ^= m_T[(uint8_t)x2][j];
+            h3 ^= m_T[(uint8_t)x3][j];
+        }
+        out[i] = h0;
+        out[i+1] = h1;
+        out[i+2] = h2;
+        out[i+3] = h3;
+    }
+    for (; i < n; ++i)
+        out[i] = (*this)(in[i]);
+}
+
+/* ***************************************************
+ * Simple Tabulation of 64-bit keys (8 characters)
+ * ***************************************************/
+
+class simpletab64
+{
+    uint32_t m_T[256][8];
+
+public:
+    typedef uint64_t key_type;
+    simpletab64();
+    void init();
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(uint64_t x) const;
+    void hash_many(const uint64_t* in, uint32_t* out, size_t n) const;
+};
+
+simpletab64::simpletab64()
+{
+}
+
+void simpletab64::init()
+{
+    init(random_seed());
+}
+
+void simpletab64::init(hash_seed seed)
+{
+    seed_rng rng(seed);
+    rng.fill(&m_T[0][0], 256*8);
+}
+
+void simpletab64::save(state_writer& out) const
+{
+    out.tag("simpletab64");
+    out.put(m_T);
+}
+
+void simpletab64::load(state_reader& in)
+{
+    in.tag("simpletab64");
+    in.get(m_T);
+}
+
+uint32_t simpletab64::operator()(uint64_t x) const
+{
+    uint32_t h=0; // Final hash value
+    for (int i = 0; i < 8; ++i, x >>= 8)
+        h ^= m_T[(uint8_t)x][i];
+    return h;
+}
+
+void simpletab64::hash_many(const uint64_t* in, uint32_t* out, size_t n) const
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint64_t x0 = in[i], x1 = in[i+1], x2 = in[i+2], x3 = in[i+3];
+        uint32_t h0 = 0, h1 = 0, h2 = 0, h3 = 0;
+        for (int j = 0; j < 8; ++j, x0 >>= 8, x1 >>= 8, x2 >>= 8, x3 >>= 8) {
+            h0 ^= m_T[(uint8_t)x0][j];
+            h1 ^= m_T[(uint8_t)x1][j];
+            h2 ^= m_T[(uint8_t)x2][j];
+            h3 ^= m_T[(uint8_t)x3][j];
+        }
+        out[i] = h0;
+        out[i+1] = h1;
+        out[i+2] = h2;
+        out[i+3] = h3;
+    }
+    for (; i < n; ++i)
+        out[i] = (*this)(in[i]);
+}
+
 /* ***************************************************
  * Twisted Tabulation
  * ***************************************************/
@@ -353,9 +1515,14 @@ class twisttab
     uint64_t mt_T1[256][4];
 
 public:
+    typedef uint32_t key_type;
     twisttab();
     void init();
-    uint32_t operator()(uint32_t x);
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(uint32_t x) const;
+    void hash_many(const uint32_t* in, uint32_t* out, size_t n) const;
 };
 
 twisttab::twisttab()
@@ -364,21 +1531,28 @@ twisttab::twisttab()
 
 void twisttab::init()
 {
-    // Use a degree-20 polynomial to fill out the entries.
-    polyhash h;
-    h.init(20);
+    init(random_seed());
+}
 
-	uint32_t x = 0;
-    for (int i = 0; i < 4; ++i) {
-        for (int j = 0; j < 256; ++j) {
-            mt_T1[j][i] = h(x++);
-            mt_T1[j][i] <<= 32;
-            mt_T1[j][i] += h(x++);
-        }
-    }
+void twisttab::init(hash_seed seed)
+{
+    seed_rng rng(seed);
+    rng.fill(&mt_T1[0][0], 256*4);
+}
+
+void twisttab::save(state_writer& out) const
+{
+    out.tag("twisttab");
+    out.put(mt_T1);
+}
+
+void twisttab::load(state_reader& in)
+{
+    in.tag("twisttab");
+    in.get(mt_T1);
 }
 
-uint32_t twisttab::operator()(uint32_t x)
+uint32_t twisttab::operator()(uint32_t x) const
 {
     uint64_t h=0; // Final hash value
     for (int i = 0; i < 3; ++i, x >>= 8)
@@ -388,4 +1562,111 @@ uint32_t twisttab::operator()(uint32_t x)
     return (uint32_t)h;
 }
 
+void twisttab::hash_many(const uint32_t* in, uint32_t* out, size_t n) const
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint32_t x0 = in[i], x1 = in[i+1], x2 = in[i+2], x3 = in[i+3];
+        uint64_t h0 = 0, h1 = 0, h2 = 0, h3 = 0;
+        for (int j = 0; j < 3; ++j, x0 >>= 8, x1 >>= 8, x2 >>= 8, x3 >>= 8) {
+            h0 ^= mt_T1[(uint8_t)x0][j];
+            h1 ^= mt_T1[(uint8_t)x1][j];
+            h2 ^= mt_T1[(uint8_t)x2][j];
+            h3 ^= mt_T1[(uint8_t)x3][j];
+        }
+        h0 ^= mt_T1[(uint8_t)(x0 ^ (uint32_t)(h0 >> 32))][3];
+        h1 ^= mt_T1[(uint8_t)(x1 ^ (uint32_t)(h1 >> 32))][3];
+        h2 ^= mt_T1[(uint8_t)(x2 ^ (uint32_t)(h2 >> 32))][3];
+        h3 ^= mt_T1[(uint8_t)(x3 ^ (uint32_t)(h3 >> 32))][3];
+        out[i] = (uint32_t)h0;
+        out[i+1] = (uint32_t)h1;
+        out[i+2] = (uint32_t)h2;
+        out[i+3] = (uint32_t)h3;
+    }
+    for (; i < n; ++i)
+        out[i] = (*this)(in[i]);
+}
+
+
+/* ***************************************************
+ * Twisted Tabulation of 64-bit keys (8 characters)
+ * ***************************************************/
+
+class twisttab64
+{
+    uint64_t mt_T1[256][8];
+
+public:
+    typedef uint64_t key_type;
+    twisttab64();
+    void init();
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(uint64_t x) const;
+    void hash_many(const uint64_t* in, uint32_t* out, size_t n) const;
+};
+
+twisttab64::twisttab64()
+{
+}
+
+void twisttab64::init()
+{
+    init(random_seed());
+}
+
+void twisttab64::init(hash_seed seed)
+{
+    seed_rng rng(seed);
+    rng.fill(&mt_T1[0][0], 256*8);
+}
+
+void twisttab64::save(state_writer& out) const
+{
+    out.tag("twisttab64");
+    out.put(mt_T1);
+}
+
+void twisttab64::load(state_reader& in)
+{
+    in.tag("twisttab64");
+    in.get(mt_T1);
+}
+
+uint32_t twisttab64::operator()(uint64_t x) const
+{
+    uint64_t h=0; // Final hash value
+    for (int i = 0; i < 7; ++i, x >>= 8)
+        h ^= mt_T1[(uint8_t)x][i];
+    uint32_t drv=h >> 32;
+    h ^= mt_T1[(uint8_t)(x^drv)][7];
+    return (uint32_t)h;
+}
+
+void twisttab64::hash_many(const uint64_t* in, uint32_t* out, size_t n) const
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint64_t x0 = in[i], x1 = in[i+1], x2 = in[i+2], x3 = in[i+3];
+        uint64_t h0 = 0, h1 = 0, h2 = 0, h3 = 0;
+        for (int j = 0; j < 7; ++j, x0 >>= 8, x1 >>= 8, x2 >>= 8, x3 >>= 8) {
+            h0 ^= mt_T1[(uint8_t)x0][j];
+            h1 ^= mt_T1[(uint8_t)x1][j];
+            h2 ^= mt_T1[(uint8_t)x2][j];
+            h3 ^= mt_T1[(uint8_t)x3][j];
+        }
+        h0 ^= mt_T1[(uint8_t)(x0 ^ (h0 >> 32))][7];
+        h1 ^= mt_T1[(uint8_t)(x1 ^ (h1 >> 32))][7];
+        h2 ^= mt_T1[(uint8_t)(x2 ^ (h2 >> 32))][7];
+        h3 ^= mt_T1[(uint8_t)(x3 ^ (h3 >> 32))][7];
+        out[i] = (uint32_t)h0;
+        out[i+1] = (uint32_t)h1;
+        out[i+2] = (uint32_t)h2;
+        out[i+3] = (uint32_t)h3;
+    }
+    for (; i < n; ++i)
+        out[i] = (*this)(in[i]);
+}
+
 #endif // _HASHING_H_
@@ -6,16 +6,28 @@
 #define _HASHING_MORE_H_
 
 #include <cstdint>
+#include <cstddef>
+#include <string>
+#include <stdexcept>
 
-// TODO: If you have a seed of random bytes you should place it in the seed
-// directory and use randomgen.h instead!
-#include <random> // TODO: Replace with #include "randomgen.h"
+// Wrappers initialized without a seed draw one with random_seed(). See
+// seeding.h on how to use a seed of random bytes instead.
+#include "seeding.h"
+#include "state.h"
+// hash_outputs for the multi-output wrapper
+#include "hashing.h"
 
 #include "MurmurHash3.h"
+#include "murmur_fixed.h"
 #include "blake2.h"
 #include "blake2-impl.h"
+#include "blake2b_keyed.h"
 
 #include "city.h"
+#include "citycrc.h"
+
+// SSE4.2 crc32 kernels and CPU detection
+#include "hashing_simd.h"
 
 /* *************************************************************
  * Wrapper for MurMurHash similar to the rest
@@ -26,60 +38,276 @@ class murmurwrap
     uint32_t m_seed;
 
 public:
+    typedef uint32_t key_type;
     murmurwrap();
     void init();
-    uint32_t operator()(uint32_t x);
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(uint32_t x) const;
+    void hash_many(const uint32_t* in, uint32_t* out, size_t n) const;
 };
 
 murmurwrap::murmurwrap() { }
 
 void murmurwrap::init()
 {
-    std::mt19937 rng;
-    rng.seed(std::random_device()());
-    std::uniform_int_distribution<uint32_t> dist;
-    m_seed = dist(rng);
-    // TODO: Replace with the line below if using randomgen.h
-    //m_seed = getRandomUInt32();
+    init(random_seed());
 }
 
-uint32_t murmurwrap::operator()(uint32_t x)
+void murmurwrap::init(hash_seed seed)
 {
-    uint32_t h;
-    MurmurHash3_x86_32(&x, 4, m_seed, &h);
-    return h;
+    m_seed = (uint32_t)seed_rng(seed)();
+}
+
+void murmurwrap::save(state_writer& out) const
+{
+    out.tag("murmurwrap");
+    out.put(m_seed);
+}
+
+void murmurwrap::load(state_reader& in)
+{
+    in.tag("murmurwrap");
+    in.get(m_seed);
+}
+
+// Same value as MurmurHash3_x86_32(&x, 4, m_seed, &h), see murmur_fixed.h
+uint32_t murmurwrap::operator()(uint32_t x) const
+{
+    return murmur3_32(x, m_seed);
+}
+
+void murmurwrap::hash_many(const uint32_t* in, uint32_t* out, size_t n) const
+{
+    size_t i = 0;
+#ifdef HASHING_X86_SIMD
+    simd_level lvl = cpu_simd_level();
+    if (lvl == SIMD_AVX512)
+        i = murmur3_32_avx512(m_seed, in, out, n);
+    else if (lvl == SIMD_AVX2)
+        i = murmur3_32_avx2(m_seed, in, out, n);
+    else if (lvl == SIMD_SSE42)
+        i = murmur3_32_sse42(m_seed, in, out, n);
+#endif
+    for (; i < n; ++i)
+        out[i] = murmur3_32(in[i], m_seed);
+}
+
+// MurmurHash of 64-bit keys
+class murmurwrap64
+{
+    uint32_t m_seed;
+
+public:
+    typedef uint64_t key_type;
+    murmurwrap64();
+    void init();
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(uint64_t x) const;
+    void hash_many(const uint64_t* in, uint32_t* out, size_t n) const;
+};
+
+murmurwrap64::murmurwrap64() { }
+
+void murmurwrap64::init()
+{
+    init(random_seed());
+}
+
+void murmurwrap64::init(hash_seed seed)
+{
+    m_seed = (uint32_t)seed_rng(seed)();
+}
+
+void murmurwrap64::save(state_writer& out) const
+{
+    out.tag("murmurwrap64");
+    out.put(m_seed);
+}
+
+void murmurwrap64::load(state_reader& in)
+{
+    in.tag("murmurwrap64");
+    in.get(m_seed);
+}
+
+uint32_t murmurwrap64::operator()(uint64_t x) const
+{
+    return murmur3_32(x, m_seed);
+}
+
+void murmurwrap64::hash_many(const uint64_t* in, uint32_t* out, size_t n) const
+{
+    size_t i = 0;
+#ifdef HASHING_X86_SIMD
+    simd_level lvl = cpu_simd_level();
+    if (lvl == SIMD_AVX512)
+        i = murmur3_32_u64_avx512(m_seed, in, out, n);
+    else if (lvl == SIMD_AVX2)
+        i = murmur3_32_u64_avx2(m_seed, in, out, n);
+    else if (lvl == SIMD_SSE42)
+        i = murmur3_32_u64_sse42(m_seed, in, out, n);
+#endif
+    for (; i < n; ++i)
+        out[i] = murmur3_32(in[i], m_seed);
 }
 
 /* **************************************************************
- * Blake2 wrapper
+ * MurmurHash3_x64_128 of 32-bit keys as four 32-bit outputs, the
+ * words of the 128-bit value in memory order. Like mixedtab_wide,
+ * sketches take the bin and the value (or sign) from one call.
  * **************************************************************/
 
-class blake2wrap
+class murmur128wrap
 {
     uint32_t m_seed;
+
+public:
+    typedef uint32_t key_type;
+    static const uint32_t outputs = 4;
+
+    murmur128wrap();
+    void init();
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(uint32_t x) const;
+    void hash_many(const uint32_t* in, uint32_t* out, size_t n) const;
+    // All outputs: out[j] for j < outputs
+    void hash_wide(uint32_t x, uint32_t* out) const;
+    // All outputs for n keys, row-major: out[i*outputs + j]
+    void hash_many_wide(const uint32_t* in, uint32_t* out, size_t n) const;
+};
+
+const uint32_t murmur128wrap::outputs;
+
+template <> struct hash_outputs<murmur128wrap> { static const uint32_t value = murmur128wrap::outputs; };
+
+murmur128wrap::murmur128wrap() { }
+
+void murmur128wrap::init()
+{
+    init(random_seed());
+}
+
+void murmur128wrap::init(hash_seed seed)
+{
+    m_seed = (uint32_t)seed_rng(seed)();
+}
+
+void murmur128wrap::save(state_writer& out) const
+{
+    out.tag("murmur128wrap");
+    out.put(m_seed);
+}
+
+void murmur128wrap::load(state_reader& in)
+{
+    in.tag("murmur128wrap");
+    in.get(m_seed);
+}
+
+uint32_t murmur128wrap::operator()(uint32_t x) const
+{
+    uint64_t h[2];
+    murmur3_128(x, m_seed, h);
+    return (uint32_t)h[0];
+}
+
+void murmur128wrap::hash_many(const uint32_t* in, uint32_t* out, size_t n) const
+{
+    uint64_t h[2];
+    for (size_t i = 0; i < n; ++i) {
+        murmur3_128(in[i], m_seed, h);
+        out[i] = (uint32_t)h[0];
+    }
+}
+
+void murmur128wrap::hash_wide(uint32_t x, uint32_t* out) const
+{
+    uint64_t h[2];
+    murmur3_128(x, m_seed, h);
+    out[0] = (uint32_t)h[0];
+    out[1] = (uint32_t)(h[0] >> 32);
+    out[2] = (uint32_t)h[1];
+    out[3] = (uint32_t)(h[1] >> 32);
+}
+
+void murmur128wrap::hash_many_wide(const uint32_t* in, uint32_t* out, size_t n) const
+{
+    for (size_t i = 0; i < n; ++i, out += outputs)
+        hash_wide(in[i], out);
+}
+
+/* **************************************************************
+ * Blake2 wrapper: keyed BLAKE2b with a 256-bit key drawn from the
+ * seed, h(x) = blake2b(out, 4, &x, 4, key, 32). The state after
+ * the key block is computed in init(), so a key costs a single
+ * compression. See blake2b_keyed.h.
+ * **************************************************************/
+
+class blake2wrap
+{
+    uint64_t m_key[4];
+    uint64_t m_h[8]; // State after the key block
 public:
+    typedef uint32_t key_type;
     blake2wrap();
     void init();
-    uint32_t operator()(uint32_t x);
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(uint32_t x) const;
+    void hash_many(const uint32_t* in, uint32_t* out, size_t n) const;
 };
 
 blake2wrap::blake2wrap() { }
 
 void blake2wrap::init()
 {
-    std::mt19937 rng;
-    rng.seed(std::random_device()());
-    std::uniform_int_distribution<uint32_t> dist;
-    m_seed = dist(rng);
-    // TODO: Replace with the line below if using randomgen.h
-    //m_seed = getRandomUInt32();
+    init(random_seed());
 }
 
-uint32_t blake2wrap::operator()(uint32_t x)
+void blake2wrap::init(hash_seed seed)
 {
-    uint32_t h;
-    blake2b(&h, 4, &x, 4, NULL, 0);
-    return h;
+    seed_rng rng(seed);
+    rng.fill(m_key, 4);
+    blake2b_keyed_state(m_key, m_h);
+}
+
+void blake2wrap::save(state_writer& out) const
+{
+    out.tag("blake2wrap");
+    out.put(m_key);
+}
+
+void blake2wrap::load(state_reader& in)
+{
+    in.tag("blake2wrap");
+    in.get(m_key);
+    blake2b_keyed_state(m_key, m_h);
+}
+
+uint32_t blake2wrap::operator()(uint32_t x) const
+{
+    return blake2b_keyed_hash(m_h, x);
+}
+
+void blake2wrap::hash_many(const uint32_t* in, uint32_t* out, size_t n) const
+{
+    size_t i = 0;
+#ifdef HASHING_X86_SIMD
+    simd_level lvl = cpu_simd_level();
+    if (lvl == SIMD_AVX512)
+        i = blake2b_keyed_avx512(m_h, in, out, n);
+    else if (lvl == SIMD_AVX2)
+        i = blake2b_keyed_avx2(m_h, in, out, n);
+#endif
+    for (; i < n; ++i)
+        out[i] = blake2b_keyed_hash(m_h, in[i]);
 }
 
 /* **************************************************************
@@ -90,28 +318,363 @@ class citywrap
 {
     uint64_t m_seed;
 public:
+    typedef uint32_t key_type;
     citywrap();
     void init();
-    uint32_t operator()(uint32_t x);
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(uint32_t x) const;
+    void hash_many(const uint32_t* in, uint32_t* out, size_t n) const;
 };
 
 citywrap::citywrap() { }
 
 void citywrap::init()
 {
-    std::mt19937 rng;
-    rng.seed(std::random_device()());
-    std::uniform_int_distribution<uint64_t> dist;
-    m_seed = dist(rng);
-    // TODO: Replace with the line below if using randomgen.h
-    //m_seed = getRandomUInt64();
+    init(random_seed());
+}
+
+void citywrap::init(hash_seed seed)
+{
+    m_seed = seed_rng(seed)();
+}
+
+void citywrap::save(state_writer& out) const
+{
+    out.tag("citywrap");
+    out.put(m_seed);
 }
 
-uint32_t citywrap::operator()(uint32_t x)
+void citywrap::load(state_reader& in)
+{
+    in.tag("citywrap");
+    in.get(m_seed);
+}
+
+uint32_t citywrap::operator()(uint32_t x) const
 {
     uint32_t h;
     h = (uint32_t)CityHash64WithSeed((const char *)&x, 4, m_seed);
     return h;
 }
 
+void citywrap::hash_many(const uint32_t* in, uint32_t* out, size_t n) const
+{
+    for (size_t i = 0; i < n; ++i)
+        out[i] = (uint32_t)CityHash64WithSeed((const char *)&in[i], 4, m_seed);
+}
+
+
+// CityHash of 64-bit keys
+class citywrap64
+{
+    uint64_t m_seed;
+public:
+    typedef uint64_t key_type;
+    citywrap64();
+    void init();
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(uint64_t x) const;
+    void hash_many(const uint64_t* in, uint32_t* out, size_t n) const;
+};
+
+citywrap64::citywrap64() { }
+
+void citywrap64::init()
+{
+    init(random_seed());
+}
+
+void citywrap64::init(hash_seed seed)
+{
+    m_seed = seed_rng(seed)();
+}
+
+void citywrap64::save(state_writer& out) const
+{
+    out.tag("citywrap64");
+    out.put(m_seed);
+}
+
+void citywrap64::load(state_reader& in)
+{
+    in.tag("citywrap64");
+    in.get(m_seed);
+}
+
+uint32_t citywrap64::operator()(uint64_t x) const
+{
+    return (uint32_t)CityHash64WithSeed((const char *)&x, 8, m_seed);
+}
+
+void citywrap64::hash_many(const uint64_t* in, uint32_t* out, size_t n) const
+{
+    for (size_t i = 0; i < n; ++i)
+        out[i] = (uint32_t)CityHash64WithSeed((const char *)&in[i], 8, m_seed);
+}
+
+
+/* **************************************************************
+ * CRC32C hashing: h(x) = crc32c(c, a*x + b mod 2^64) with random
+ * c, b and odd a, using the SSE4.2 crc32 instruction if the CPU
+ * has it and a table otherwise. Both give the same values. CRC
+ * is affine over GF(2), so crc32c(c, x) alone collides on the
+ * same pairs of keys for every c. The seeded multiply makes the
+ * colliding pairs depend on the seed, but this is still the
+ * cheapest seeded hash and gives no independence guarantees.
+ * **************************************************************/
+
+// Castagnoli polynomial, bit-reflected
+const uint32_t crc32c_poly = 0x82F63B78;
+
+struct crc32c_table
+{
+    uint32_t t[256];
+    crc32c_table()
+    {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int j = 0; j < 8; ++j)
+                c = (c >> 1) ^ (crc32c_poly & (0 - (c & 1)));
+            t[i] = c;
+        }
+    }
+};
+
+// crc32c of the len bytes at p, without pre- and post-inversion, the same
+// as the crc32 instruction.
+uint32_t crc32c_sw(uint32_t crc, const unsigned char* p, size_t len)
+{
+    static const crc32c_table table;
+    for (size_t i = 0; i < len; ++i)
+        crc = table.t[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+class crc32hash
+{
+    uint32_t m_seed; // Initial CRC value
+    uint64_t m_a;    // Odd
+    uint64_t m_b;
+
+public:
+    typedef uint32_t key_type;
+    crc32hash();
+    void init();
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(uint32_t x) const;
+    void hash_many(const uint32_t* in, uint32_t* out, size_t n) const;
+};
+
+crc32hash::crc32hash() { }
+
+void crc32hash::init()
+{
+    init(random_seed());
+}
+
+void crc32hash::init(hash_seed seed)
+{
+    seed_rng rng(seed);
+    m_seed = (uint32_t)rng();
+    m_a = rng() | 1;
+    m_b = rng();
+}
+
+void crc32hash::save(state_writer& out) const
+{
+    out.tag("crc32hash");
+    out.put(m_seed);
+    out.put(m_a);
+    out.put(m_b);
+}
+
+void crc32hash::load(state_reader& in)
+{
+    in.tag("crc32hash");
+    in.get(m_seed);
+    in.get(m_a);
+    in.get(m_b);
+    if ((m_a & 1) == 0)
+        throw state_error("bad crc32hash multiplier");
+}
+
+uint32_t crc32hash::operator()(uint32_t x) const
+{
+    uint64_t y = m_a * x + m_b;
+#ifdef HASHING_X86_SIMD
+    if (cpu_has_sse42())
+        return crc32c_u64_sse42(m_seed, y);
+#endif
+    return crc32c_sw(m_seed, (const unsigned char*)&y, 8);
+}
+
+void crc32hash::hash_many(const uint32_t* in, uint32_t* out, size_t n) const
+{
+    size_t i = 0;
+#ifdef HASHING_X86_SIMD
+    if (cpu_has_sse42())
+        i = crc32c_sse42(m_seed, m_a, m_b, in, out, n);
+#endif
+    for (; i < n; ++i)
+        out[i] = (*this)(in[i]);
+}
+
+// CRC32C of 64-bit keys
+class crc32hash64
+{
+    uint32_t m_seed; // Initial CRC value
+    uint64_t m_a;    // Odd
+    uint64_t m_b;
+
+public:
+    typedef uint64_t key_type;
+    crc32hash64();
+    void init();
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(uint64_t x) const;
+    void hash_many(const uint64_t* in, uint32_t* out, size_t n) const;
+};
+
+crc32hash64::crc32hash64() { }
+
+void crc32hash64::init()
+{
+    init(random_seed());
+}
+
+void crc32hash64::init(hash_seed seed)
+{
+    seed_rng rng(seed);
+    m_seed = (uint32_t)rng();
+    m_a = rng() | 1;
+    m_b = rng();
+}
+
+void crc32hash64::save(state_writer& out) const
+{
+    out.tag("crc32hash64");
+    out.put(m_seed);
+    out.put(m_a);
+    out.put(m_b);
+}
+
+void crc32hash64::load(state_reader& in)
+{
+    in.tag("crc32hash64");
+    in.get(m_seed);
+    in.get(m_a);
+    in.get(m_b);
+    if ((m_a & 1) == 0)
+        throw state_error("bad crc32hash64 multiplier");
+}
+
+uint32_t crc32hash64::operator()(uint64_t x) const
+{
+    uint64_t y = m_a * x + m_b;
+#ifdef HASHING_X86_SIMD
+    if (cpu_has_sse42())
+        return crc32c_u64_sse42(m_seed, y);
+#endif
+    return crc32c_sw(m_seed, (const unsigned char*)&y, 8);
+}
+
+void crc32hash64::hash_many(const uint64_t* in, uint32_t* out, size_t n) const
+{
+    size_t i = 0;
+#ifdef HASHING_X86_SIMD
+    if (cpu_has_sse42())
+        i = crc32c64_sse42(m_seed, m_a, m_b, in, out, n);
+#endif
+    for (; i < n; ++i)
+        out[i] = (*this)(in[i]);
+}
+
+#ifdef HASHING_X86_SIMD
+/* **************************************************************
+ * CityHashCrc wrapper for long keys, e.g. shingles or documents.
+ * The keys are strings, so sketches of this hash function take
+ * sets of strings. CityHashCrc128WithSeed only uses crc32 for
+ * keys longer than 900 bytes; shorter keys are hashed by plain
+ * CityHash128WithSeed, so use crc32hash or citywrap for short
+ * keys. Requires SSE4.2: available() tells if it can be used and
+ * init() throws if not. HASHING_SIMD=scalar also disables it, as
+ * for the other SSE4.2 code, so drivers should check available()
+ * and skip it.
+ * **************************************************************/
+
+class citycrcwrap
+{
+    uint64_t m_seed[2];
+
+public:
+    typedef std::string key_type;
+    citycrcwrap();
+    static bool available();
+    void init();
+    void init(hash_seed seed);
+    void save(state_writer& out) const;
+    void load(state_reader& in);
+    uint32_t operator()(const char* s, size_t len) const;
+    uint32_t operator()(const std::string& x) const;
+    void hash_many(const std::string* in, uint32_t* out, size_t n) const;
+};
+
+citycrcwrap::citycrcwrap() { }
+
+bool citycrcwrap::available()
+{
+    return cpu_has_sse42();
+}
+
+void citycrcwrap::init()
+{
+    init(random_seed());
+}
+
+void citycrcwrap::init(hash_seed seed)
+{
+    if (!available())
+        throw std::runtime_error("citycrcwrap requires SSE4.2 (not available or disabled by HASHING_SIMD)");
+    seed_rng rng(seed);
+    m_seed[0] = rng();
+    m_seed[1] = rng();
+}
+
+void citycrcwrap::save(state_writer& out) const
+{
+    out.tag("citycrcwrap");
+    out.put(m_seed);
+}
+
+void citycrcwrap::load(state_reader& in)
+{
+    in.tag("citycrcwrap");
+    in.get(m_seed);
+}
+
+uint32_t citycrcwrap::operator()(const char* s, size_t len) const
+{
+    return (uint32_t)Uint128Low64(CityHashCrc128WithSeed(s, len, uint128(m_seed[0], m_seed[1])));
+}
+
+uint32_t citycrcwrap::operator()(const std::string& x) const
+{
+    return (*this)(x.data(), x.size());
+}
+
+void citycrcwrap::hash_many(const std::string* in, uint32_t* out, size_t n) const
+{
+    for (size_t i = 0; i < n; ++i)
+        out[i] = (*this)(in[i]);
+}
+#endif // HASHING_X86_SIMD
+
 #endif //_HASHING_MORE_H_
@@ -0,0 +1,410 @@
+/* ***********************************************
+ * SIMD kernels for the batched hash functions:
+ * Each kernel hashes the largest prefix of the
+ * input that fills whole vectors and returns its
+ * length. The caller finishes the tail with the
+ * scalar code. All kernels are bit-identical to
+ * the scalar operator().
+ *
+ * The kernels are compiled for their target with
+ * function attributes and must only be called if
+ * cpu_simd_level() (or cpu_has_sse42() for the CRC
+ * kernels) reports support.
+ * ***********************************************/
+
+#ifndef _HASHING_SIMD_H_
+#define _HASHING_SIMD_H_
+
+#include <cstdint>
+#include <cstddef>
+
+#include "cpufeatures.h"
+
+#ifdef HASHING_X86_SIMD
+
+#include <immintrin.h>
+
+// The AVX-512 shift and multiply intrinsics of GCC 12 read a deliberately
+// undefined vector, which -Wall reports once they are inlined here.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+/* ***************************************************
+ * SSE4.2: the crc32 instruction has a latency of 3
+ * cycles but a throughput of one per cycle, so four
+ * independent keys keep it busy. The keys are first
+ * mapped to a*x + b mod 2^64, see crc32hash.
+ * ***************************************************/
+
+__attribute__((target("sse4.2")))
+uint32_t crc32c_u64_sse42(uint32_t crc, uint64_t x)
+{
+    return (uint32_t)_mm_crc32_u64(crc, x);
+}
+
+__attribute__((target("sse4.2")))
+size_t crc32c_sse42(uint32_t seed, uint64_t a, uint64_t b, const uint32_t* in, uint32_t* out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        out[i] = (uint32_t)_mm_crc32_u64(seed, a * in[i] + b);
+        out[i+1] = (uint32_t)_mm_crc32_u64(seed, a * in[i+1] + b);
+        out[i+2] = (uint32_t)_mm_crc32_u64(seed, a * in[i+2] + b);
+        out[i+3] = (uint32_t)_mm_crc32_u64(seed, a * in[i+3] + b);
+    }
+    for (; i < n; ++i)
+        out[i] = (uint32_t)_mm_crc32_u64(seed, a * in[i] + b);
+    return n;
+}
+
+__attribute__((target("sse4.2")))
+size_t crc32c64_sse42(uint32_t seed, uint64_t a, uint64_t b, const uint64_t* in, uint32_t* out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        out[i] = (uint32_t)_mm_crc32_u64(seed, a * in[i] + b);
+        out[i+1] = (uint32_t)_mm_crc32_u64(seed, a * in[i+1] + b);
+        out[i+2] = (uint32_t)_mm_crc32_u64(seed, a * in[i+2] + b);
+        out[i+3] = (uint32_t)_mm_crc32_u64(seed, a * in[i+3] + b);
+    }
+    for (; i < n; ++i)
+        out[i] = (uint32_t)_mm_crc32_u64(seed, a * in[i] + b);
+    return n;
+}
+
+/* ***************************************************
+ * AVX2: 8 keys per vector.
+ * Keys are processed as two halves of 64-bit lanes:
+ * the even keys sit in the low words already and the
+ * odd keys are shifted down. The 32-bit results are
+ * blended back together in key order.
+ * ***************************************************/
+
+// Low 64 bits of a*x + b where x < 2^32 is the low word of each lane.
+__attribute__((target("avx2")))
+static inline __m256i mulshift_lo64_avx2(__m256i x, __m256i alo, __m256i ahi, __m256i b)
+{
+    __m256i lo = _mm256_mul_epu32(x, alo);
+    __m256i hi = _mm256_mul_epu32(x, ahi);
+    return _mm256_add_epi64(_mm256_add_epi64(lo, b), _mm256_slli_epi64(hi, 32));
+}
+
+// Reduce modulo 2^61-1 once: (h & p) + (h >> 61)
+__attribute__((target("avx2")))
+static inline __m256i mersenne_fold_avx2(__m256i h, __m256i p)
+{
+    return _mm256_add_epi64(_mm256_and_si256(h, p), _mm256_srli_epi64(h, 61));
+}
+
+// Combine the low words of the even and odd lane results.
+__attribute__((target("avx2")))
+static inline __m256i merge_lanes_avx2(__m256i even, __m256i odd)
+{
+    return _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+}
+
+__attribute__((target("avx2")))
+size_t multishift_avx2(uint64_t a, uint64_t b, const uint32_t* in, uint32_t* out, size_t n)
+{
+    const __m256i valo = _mm256_set1_epi64x(a & 0xFFFFFFFF);
+    const __m256i vahi = _mm256_set1_epi64x(a >> 32);
+    const __m256i vb = _mm256_set1_epi64x(b);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(in + i));
+        __m256i xo = _mm256_srli_epi64(x, 32);
+        __m256i he = _mm256_srli_epi64(mulshift_lo64_avx2(x, valo, vahi, vb), 32);
+        __m256i ho = _mm256_srli_epi64(mulshift_lo64_avx2(xo, valo, vahi, vb), 32);
+        _mm256_storeu_si256((__m256i*)(out + i), merge_lanes_avx2(he, ho));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i polyhash2_lane_avx2(__m256i x, __m256i alo, __m256i ahi, __m256i b, __m256i p)
+{
+    __m256i h = mulshift_lo64_avx2(x, alo, ahi, b);
+    h = mersenne_fold_avx2(h, p);
+    return mersenne_fold_avx2(h, p);
+}
+
+__attribute__((target("avx2")))
+size_t polyhash2_avx2(uint64_t a, uint64_t b, const uint32_t* in, uint32_t* out, size_t n)
+{
+    const __m256i valo = _mm256_set1_epi64x(a & 0xFFFFFFFF);
+    const __m256i vahi = _mm256_set1_epi64x(a >> 32);
+    const __m256i vb = _mm256_set1_epi64x(b);
+    const __m256i vp = _mm256_set1_epi64x(2305843009213693951ULL);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(in + i));
+        __m256i xo = _mm256_srli_epi64(x, 32);
+        __m256i he = polyhash2_lane_avx2(x, valo, vahi, vb, vp);
+        __m256i ho = polyhash2_lane_avx2(xo, valo, vahi, vb, vp);
+        _mm256_storeu_si256((__m256i*)(out + i), merge_lanes_avx2(he, ho));
+    }
+    return i;
+}
+
+// The second Horner step multiplies a 62-bit value by the key, so the
+// 94-bit product is assembled from two 32x32 products. Only its low 61 bits
+// and the bits above are needed for the Mersenne fold.
+__attribute__((target("avx2")))
+static inline __m256i polyhash3_lane_avx2(__m256i x, __m256i alo, __m256i ahi,
+        __m256i b, __m256i clo, __m256i chi, __m256i p)
+{
+    const __m256i m32 = _mm256_set1_epi64x(0xFFFFFFFF);
+    const __m256i m29 = _mm256_set1_epi64x(0x1FFFFFFF);
+    __m256i h = mersenne_fold_avx2(mulshift_lo64_avx2(x, alo, ahi, b), p);
+    __m256i p1 = _mm256_mul_epu32(h, x);
+    __m256i p2 = _mm256_mul_epu32(_mm256_srli_epi64(h, 32), x);
+    __m256i lo = _mm256_add_epi64(_mm256_and_si256(p1, m32), clo);
+    __m256i mid = _mm256_add_epi64(_mm256_add_epi64(p2, _mm256_srli_epi64(p1, 32)),
+            _mm256_add_epi64(chi, _mm256_srli_epi64(lo, 32)));
+    h = _mm256_or_si256(_mm256_slli_epi64(_mm256_and_si256(mid, m29), 32),
+            _mm256_and_si256(lo, m32));
+    h = _mm256_add_epi64(h, _mm256_srli_epi64(mid, 29));
+    return mersenne_fold_avx2(h, p);
+}
+
+__attribute__((target("avx2")))
+size_t polyhash3_avx2(uint64_t a, uint64_t b, uint64_t c, const uint32_t* in, uint32_t* out, size_t n)
+{
+    const __m256i valo = _mm256_set1_epi64x(a & 0xFFFFFFFF);
+    const __m256i vahi = _mm256_set1_epi64x(a >> 32);
+    const __m256i vb = _mm256_set1_epi64x(b);
+    const __m256i vclo = _mm256_set1_epi64x(c & 0xFFFFFFFF);
+    const __m256i vchi = _mm256_set1_epi64x(c >> 32);
+    const __m256i vp = _mm256_set1_epi64x(2305843009213693951ULL);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(in + i));
+        __m256i xo = _mm256_srli_epi64(x, 32);
+        __m256i he = polyhash3_lane_avx2(x, valo, vahi, vb, vclo, vchi, vp);
+        __m256i ho = polyhash3_lane_avx2(xo, valo, vahi, vb, vclo, vchi, vp);
+        _mm256_storeu_si256((__m256i*)(out + i), merge_lanes_avx2(he, ho));
+    }
+    return i;
+}
+
+/* ***************************************************
+ * Tabulation with AVX2 gathers. The tables are laid
+ * out as T[char][pos], so the entry for character c
+ * at position j is word 4*c + j of the table. Every
+ * position costs one gather of 8 entries, and the
+ * gathered entries are XORed into the lanes.
+ * ***************************************************/
+
+// Word index of character pos of each key: 4*byte + pos.
+__attribute__((target("avx2")))
+static inline __m256i tab_index_avx2(__m256i x, int pos)
+{
+    const __m256i m8 = _mm256_set1_epi32(0xFF);
+    __m256i c = _mm256_and_si256(_mm256_srli_epi32(x, 8*pos), m8);
+    return _mm256_add_epi32(_mm256_slli_epi32(c, 2), _mm256_set1_epi32(pos));
+}
+
+__attribute__((target("avx2")))
+size_t simpletab_avx2(const uint32_t* T, const uint32_t* in, uint32_t* out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(in + i));
+        __m256i h = _mm256_i32gather_epi32((const int*)T, tab_index_avx2(x, 0), 4);
+        h = _mm256_xor_si256(h, _mm256_i32gather_epi32((const int*)T, tab_index_avx2(x, 1), 4));
+        h = _mm256_xor_si256(h, _mm256_i32gather_epi32((const int*)T, tab_index_avx2(x, 2), 4));
+        h = _mm256_xor_si256(h, _mm256_i32gather_epi32((const int*)T, tab_index_avx2(x, 3), 4));
+        _mm256_storeu_si256((__m256i*)(out + i), h);
+    }
+    return i;
+}
+
+// T1 holds 64-bit entries. The low and high words are gathered separately:
+// the low words go to the output and the high words form the derived
+// characters that index T2.
+__attribute__((target("avx2")))
+size_t mixedtab_avx2(const uint64_t* T1, const uint32_t* T2, const uint32_t* in, uint32_t* out, size_t n)
+{
+    const int* lo = (const int*)T1;
+    const int* hi = lo + 1;
+    const int* t2 = (const int*)T2;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(in + i));
+        __m256i h = _mm256_setzero_si256();
+        __m256i drv = _mm256_setzero_si256();
+        for (int j = 0; j < 4; ++j) {
+            __m256i idx = _mm256_slli_epi32(tab_index_avx2(x, j), 1);
+            h = _mm256_xor_si256(h, _mm256_i32gather_epi32(lo, idx, 4));
+            drv = _mm256_xor_si256(drv, _mm256_i32gather_epi32(hi, idx, 4));
+        }
+        for (int j = 0; j < 4; ++j)
+            h = _mm256_xor_si256(h, _mm256_i32gather_epi32(t2, tab_index_avx2(drv, j), 4));
+        _mm256_storeu_si256((__m256i*)(out + i), h);
+    }
+    return i;
+}
+
+/* ***************************************************
+ * AVX-512: 16 keys per vector. Same scheme as above.
+ * ***************************************************/
+
+__attribute__((target("avx512f")))
+static inline __m512i mulshift_lo64_avx512(__m512i x, __m512i alo, __m512i ahi, __m512i b)
+{
+    __m512i lo = _mm512_mul_epu32(x, alo);
+    __m512i hi = _mm512_mul_epu32(x, ahi);
+    return _mm512_add_epi64(_mm512_add_epi64(lo, b), _mm512_slli_epi64(hi, 32));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i mersenne_fold_avx512(__m512i h, __m512i p)
+{
+    return _mm512_add_epi64(_mm512_and_si512(h, p), _mm512_srli_epi64(h, 61));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i merge_lanes_avx512(__m512i even, __m512i odd)
+{
+    return _mm512_mask_blend_epi32(0xAAAA, even, _mm512_slli_epi64(odd, 32));
+}
+
+__attribute__((target("avx512f")))
+size_t multishift_avx512(uint64_t a, uint64_t b, const uint32_t* in, uint32_t* out, size_t n)
+{
+    const __m512i valo = _mm512_set1_epi64(a & 0xFFFFFFFF);
+    const __m512i vahi = _mm512_set1_epi64(a >> 32);
+    const __m512i vb = _mm512_set1_epi64(b);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i x = _mm512_loadu_si512((const void*)(in + i));
+        __m512i xo = _mm512_srli_epi64(x, 32);
+        __m512i he = _mm512_srli_epi64(mulshift_lo64_avx512(x, valo, vahi, vb), 32);
+        __m512i ho = _mm512_srli_epi64(mulshift_lo64_avx512(xo, valo, vahi, vb), 32);
+        _mm512_storeu_si512((void*)(out + i), merge_lanes_avx512(he, ho));
+    }
+    return i;
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i polyhash2_lane_avx512(__m512i x, __m512i alo, __m512i ahi, __m512i b, __m512i p)
+{
+    __m512i h = mulshift_lo64_avx512(x, alo, ahi, b);
+    h = mersenne_fold_avx512(h, p);
+    return mersenne_fold_avx512(h, p);
+}
+
+__attribute__((target("avx512f")))
+size_t polyhash2_avx512(uint64_t a, uint64_t b, const uint32_t* in, uint32_t* out, size_t n)
+{
+    const __m512i valo = _mm512_set1_epi64(a & 0xFFFFFFFF);
+    const __m512i vahi = _mm512_set1_epi64(a >> 32);
+    const __m512i vb = _mm512_set1_epi64(b);
+    const __m512i vp = _mm512_set1_epi64(2305843009213693951ULL);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i x = _mm512_loadu_si512((const void*)(in + i));
+        __m512i xo = _mm512_srli_epi64(x, 32);
+        __m512i he = polyhash2_lane_avx512(x, valo, vahi, vb, vp);
+        __m512i ho = polyhash2_lane_avx512(xo, valo, vahi, vb, vp);
+        _mm512_storeu_si512((void*)(out + i), merge_lanes_avx512(he, ho));
+    }
+    return i;
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i polyhash3_lane_avx512(__m512i x, __m512i alo, __m512i ahi,
+        __m512i b, __m512i clo, __m512i chi, __m512i p)
+{
+    const __m512i m32 = _mm512_set1_epi64(0xFFFFFFFF);
+    const __m512i m29 = _mm512_set1_epi64(0x1FFFFFFF);
+    __m512i h = mersenne_fold_avx512(mulshift_lo64_avx512(x, alo, ahi, b), p);
+    __m512i p1 = _mm512_mul_epu32(h, x);
+    __m512i p2 = _mm512_mul_epu32(_mm512_srli_epi64(h, 32), x);
+    __m512i lo = _mm512_add_epi64(_mm512_and_si512(p1, m32), clo);
+    __m512i mid = _mm512_add_epi64(_mm512_add_epi64(p2, _mm512_srli_epi64(p1, 32)),
+            _mm512_add_epi64(chi, _mm512_srli_epi64(lo, 32)));
+    h = _mm512_or_si512(_mm512_slli_epi64(_mm512_and_si512(mid, m29), 32),
+            _mm512_and_si512(lo, m32));
+    h = _mm512_add_epi64(h, _mm512_srli_epi64(mid, 29));
+    return mersenne_fold_avx512(h, p);
+}
+
+__attribute__((target("avx512f")))
+size_t polyhash3_avx512(uint64_t a, uint64_t b, uint64_t c, const uint32_t* in, uint32_t* out, size_t n)
+{
+    const __m512i valo = _mm512_set1_epi64(a & 0xFFFFFFFF);
+    const __m512i vahi = _mm512_set1_epi64(a >> 32);
+    const __m512i vb = _mm512_set1_epi64(b);
+    const __m512i vclo = _mm512_set1_epi64(c & 0xFFFFFFFF);
+    const __m512i vchi = _mm512_set1_epi64(c >> 32);
+    const __m512i vp = _mm512_set1_epi64(2305843009213693951ULL);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i x = _mm512_loadu_si512((const void*)(in + i));
+        __m512i xo = _mm512_srli_epi64(x, 32);
+        __m512i he = polyhash3_lane_avx512(x, valo, vahi, vb, vclo, vchi, vp);
+        __m512i ho = polyhash3_lane_avx512(xo, valo, vahi, vb, vclo, vchi, vp);
+        _mm512_storeu_si512((void*)(out + i), merge_lanes_avx512(he, ho));
+    }
+    return i;
+}
+
+/* ***************************************************
+ * Tabulation with AVX-512 gathers: 16 keys at once.
+ * ***************************************************/
+
+__attribute__((target("avx512f")))
+static inline __m512i tab_index_avx512(__m512i x, int pos)
+{
+    const __m512i m8 = _mm512_set1_epi32(0xFF);
+    __m512i c = _mm512_and_si512(_mm512_srli_epi32(x, 8*pos), m8);
+    return _mm512_add_epi32(_mm512_slli_epi32(c, 2), _mm512_set1_epi32(pos));
+}
+
+__attribute__((target("avx512f")))
+size_t simpletab_avx512(const uint32_t* T, const uint32_t* in, uint32_t* out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i x = _mm512_loadu_si512((const void*)(in + i));
+        __m512i h = _mm512_i32gather_epi32(tab_index_avx512(x, 0), (const void*)T, 4);
+        h = _mm512_xor_si512(h, _mm512_i32gather_epi32(tab_index_avx512(x, 1), (const void*)T, 4));
+        h = _mm512_xor_si512(h, _mm512_i32gather_epi32(tab_index_avx512(x, 2), (const void*)T, 4));
+        h = _mm512_xor_si512(h, _mm512_i32gather_epi32(tab_index_avx512(x, 3), (const void*)T, 4));
+        _mm512_storeu_si512((void*)(out + i), h);
+    }
+    return i;
+}
+
+__attribute__((target("avx512f")))
+size_t mixedtab_avx512(const uint64_t* T1, const uint32_t* T2, const uint32_t* in, uint32_t* out, size_t n)
+{
+    const uint32_t* lo = (const uint32_t*)T1;
+    const uint32_t* hi = lo + 1;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i x = _mm512_loadu_si512((const void*)(in + i));
+        __m512i h = _mm512_setzero_si512();
+        __m512i drv = _mm512_setzero_si512();
+        for (int j = 0; j < 4; ++j) {
+            __m512i idx = _mm512_slli_epi32(tab_index_avx512(x, j), 1);
+            h = _mm512_xor_si512(h, _mm512_i32gather_epi32(idx, (const void*)lo, 4));
+            drv = _mm512_xor_si512(drv, _mm512_i32gather_epi32(idx, (const void*)hi, 4));
+        }
+        for (int j = 0; j < 4; ++j)
+            h = _mm512_xor_si512(h, _mm512_i32gather_epi32(tab_index_avx512(drv, j), (const void*)T2, 4));
+        _mm512_storeu_si512((void*)(out + i), h);
+    }
+    return i;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // HASHING_X86_SIMD
+
+#endif // _HASHING_SIMD_H_
@@ -0,0 +1,153 @@
+/* ***********************************************
+ * Shared hash function tables:
+ * pooled<F> is a hash function with the same
+ * interface as F, but F itself lives in a pool of
+ * read-only instances keyed by seed. Hash functions
+ * initialized with the same seed share one set of
+ * tables, so many sketches and threads can use one
+ * copy of e.g. the 12KB mixed tabulation tables and
+ * keep it hot in the shared caches.
+ *
+ * Instances are reference counted and released when
+ * the last pooled<F> using them is destroyed.
+ * Lookups lock a mutex, evaluation does not.
+ *
+ * Example:
+ *     f_hash<pooled<mixedtab>> fh(256, seed);
+ * ***********************************************/
+
+#ifndef _HASHPOOL_H_
+#define _HASHPOOL_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
+#include "seeding.h"
+#include "hashing.h"
+#include "state.h"
+
+template <class F>
+class hash_pool
+{
+    static std::mutex& lock();
+    static std::map<uint64_t, std::weak_ptr<const F>>& instances();
+    // Map size at which get() next drops the entries of released instances.
+    static size_t& sweep_at();
+
+public:
+    // The instance of F initialized with seed. It is created on first use.
+    static std::shared_ptr<const F> get(hash_seed seed);
+    // Number of live instances.
+    static size_t size();
+};
+
+template <class F>
+std::mutex& hash_pool<F>::lock()
+{
+    static std::mutex m;
+    return m;
+}
+
+template <class F>
+std::map<uint64_t, std::weak_ptr<const F>>& hash_pool<F>::instances()
+{
+    static std::map<uint64_t, std::weak_ptr<const F>> m;
+    return m;
+}
+
+template <class F>
+size_t& hash_pool<F>::sweep_at()
+{
+    static size_t n = 16;
+    return n;
+}
+
+template <class F>
+std::shared_ptr<const F> hash_pool<F>::get(hash_seed seed)
+{
+    std::lock_guard<std::mutex> guard(lock());
+    std::map<uint64_t, std::weak_ptr<const F>>& m = instances();
+
+    std::weak_ptr<const F>& slot = m[seed.value];
+    std::shared_ptr<const F> res = slot.lock();
+    if (res)
+        return res;
+
+    // Drop the entries of released instances once the map has doubled
+    // since the last sweep, so it does not grow with the number of seeds
+    // ever used. At least half of the entries were added since, so a miss
+    // costs O(log n) amortised.
+    if (m.size() >= sweep_at()) {
+        for (auto it = m.begin(); it != m.end(); ) {
+            if (it->second.expired() && &it->second != &slot)
+                it = m.erase(it);
+            else
+                ++it;
+        }
+        sweep_at() = std::max((size_t)16, 2 * m.size());
+    }
+
+    std::shared_ptr<F> h = std::make_shared<F>();
+    h->init(seed);
+    slot = h;
+    return h;
+}
+
+template <class F>
+size_t hash_pool<F>::size()
+{
+    std::lock_guard<std::mutex> guard(lock());
+    size_t cnt = 0;
+    for (auto it = instances().begin(); it != instances().end(); ++it)
+        if (!it->second.expired())
+            ++cnt;
+    return cnt;
+}
+
+template <class F>
+class pooled
+{
+    std::shared_ptr<const F> m_h;
+
+public:
+    typedef typename F::key_type key_type;
+    void init();
+    void init(hash_seed seed);
+    // A loaded hash function has no seed, so it is not shared with others.
+    void save(state_writer& out) const { m_h->save(out); }
+    void load(state_reader& in);
+    uint32_t operator()(key_type x) const { return (*m_h)(x); }
+    void hash_many(const key_type* in, uint32_t* out, size_t n) const { m_h->hash_many(in, out, n); }
+
+    // Only available if F has several outputs.
+    void hash_wide(key_type x, uint32_t* out) const { m_h->hash_wide(x, out); }
+    void hash_many_wide(const key_type* in, uint32_t* out, size_t n) const { m_h->hash_many_wide(in, out, n); }
+};
+
+template <class F>
+void pooled<F>::init()
+{
+    init(random_seed());
+}
+
+template <class F>
+void pooled<F>::init(hash_seed seed)
+{
+    m_h = hash_pool<F>::get(seed);
+}
+
+template <class F>
+void pooled<F>::load(state_reader& in)
+{
+    std::shared_ptr<F> h = std::make_shared<F>();
+    h->load(in);
+    m_h = h;
+}
+
+template <class F> struct hash_outputs<pooled<F>> { static const uint32_t value = hash_outputs<F>::value; };
+
+#endif // _HASHPOOL_H_
@@ -0,0 +1,335 @@
+/* ***********************************************
+ * MurmurHash3 of fixed-width keys:
+ * The general MurmurHash3 functions loop over
+ * blocks and switch on the tail length. For a
+ * single 32-bit or 64-bit key both are known at
+ * compile time, so the functions below are the
+ * same computation with the loop and the switch
+ * written out. They are bit-identical to
+ *     MurmurHash3_x86_32(&x, sizeof(x), seed, out)
+ *     MurmurHash3_x64_128(&x, 4, seed, out)
+ * on little-endian machines.
+ *
+ * The batch kernels hash one key per 32-bit vector
+ * lane. Like the other kernels in hashing_simd.h
+ * they return the number of keys hashed and must
+ * only be called if cpu_simd_level() reports
+ * support.
+ * ***********************************************/
+
+#ifndef _MURMUR_FIXED_H_
+#define _MURMUR_FIXED_H_
+
+#include <cstdint>
+#include <cstddef>
+
+#include "cpufeatures.h"
+
+#ifdef HASHING_X86_SIMD
+#include <immintrin.h>
+#endif
+
+const uint32_t murmur3_c1 = 0xcc9e2d51;
+const uint32_t murmur3_c2 = 0x1b873593;
+const uint64_t murmur3_c1_64 = 0x87c37b91114253d5ULL;
+const uint64_t murmur3_c2_64 = 0x4cf5ad432745937fULL;
+
+/* ***************************************************
+ * Scalar
+ * ***************************************************/
+
+static inline uint32_t murmur3_rotl32(uint32_t x, int r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+static inline uint64_t murmur3_rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint32_t murmur3_fmix32(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+static inline uint64_t murmur3_fmix64(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// One body block of MurmurHash3_x86_32
+static inline uint32_t murmur3_block32(uint32_t h, uint32_t k)
+{
+    k *= murmur3_c1;
+    k = murmur3_rotl32(k, 15);
+    k *= murmur3_c2;
+    h ^= k;
+    h = murmur3_rotl32(h, 13);
+    return h*5 + 0xe6546b64;
+}
+
+inline uint32_t murmur3_32(uint32_t x, uint32_t seed)
+{
+    uint32_t h = murmur3_block32(seed, x);
+    return murmur3_fmix32(h ^ 4);
+}
+
+inline uint32_t murmur3_32(uint64_t x, uint32_t seed)
+{
+    uint32_t h = murmur3_block32(seed, (uint32_t)x);
+    h = murmur3_block32(h, (uint32_t)(x >> 32));
+    return murmur3_fmix32(h ^ 8);
+}
+
+// MurmurHash3_x64_128 of a 32-bit key. The key is the tail of the first
+// 64-bit lane, the second lane is empty.
+inline void murmur3_128(uint32_t x, uint32_t seed, uint64_t out[2])
+{
+    uint64_t h1 = seed;
+    uint64_t h2 = seed;
+
+    uint64_t k1 = x;
+    k1 *= murmur3_c1_64;
+    k1 = murmur3_rotl64(k1, 31);
+    k1 *= murmur3_c2_64;
+    h1 ^= k1;
+
+    h1 ^= 4;
+    h2 ^= 4;
+    h1 += h2;
+    h2 += h1;
+    h1 = murmur3_fmix64(h1);
+    h2 = murmur3_fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+
+    out[0] = h1;
+    out[1] = h2;
+}
+
+#ifdef HASHING_X86_SIMD
+
+// See hashing_simd.h: GCC 12's AVX-512 intrinsics trip -Wmaybe-uninitialized.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+/* ***************************************************
+ * SSE4.2: 4 keys per vector (pmulld is SSE4.1).
+ * ***************************************************/
+
+__attribute__((target("sse4.2")))
+static inline __m128i murmur3_rotl32_sse42(__m128i x, int r)
+{
+    return _mm_or_si128(_mm_slli_epi32(x, r), _mm_srli_epi32(x, 32 - r));
+}
+
+__attribute__((target("sse4.2")))
+static inline __m128i murmur3_block32_sse42(__m128i h, __m128i k)
+{
+    k = _mm_mullo_epi32(k, _mm_set1_epi32(murmur3_c1));
+    k = murmur3_rotl32_sse42(k, 15);
+    k = _mm_mullo_epi32(k, _mm_set1_epi32(murmur3_c2));
+    h = murmur3_rotl32_sse42(_mm_xor_si128(h, k), 13);
+    h = _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(h, 2), h), _mm_set1_epi32(0xe6546b64));
+    return h;
+}
+
+__attribute__((target("sse4.2")))
+static inline __m128i murmur3_fmix32_sse42(__m128i h)
+{
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+    h = _mm_mullo_epi32(h, _mm_set1_epi32(0x85ebca6b));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 13));
+    h = _mm_mullo_epi32(h, _mm_set1_epi32(0xc2b2ae35));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+    return h;
+}
+
+__attribute__((target("sse4.2")))
+size_t murmur3_32_sse42(uint32_t seed, const uint32_t* in, uint32_t* out, size_t n)
+{
+    const __m128i s = _mm_set1_epi32(seed);
+    const __m128i len = _mm_set1_epi32(4);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(in + i));
+        __m128i h = murmur3_block32_sse42(s, x);
+        h = murmur3_fmix32_sse42(_mm_xor_si128(h, len));
+        _mm_storeu_si128((__m128i*)(out + i), h);
+    }
+    return i;
+}
+
+// 64-bit keys: the low and high words of two keys are split with shuffles.
+__attribute__((target("sse4.2")))
+size_t murmur3_32_u64_sse42(uint32_t seed, const uint64_t* in, uint32_t* out, size_t n)
+{
+    const __m128i s = _mm_set1_epi32(seed);
+    const __m128i len = _mm_set1_epi32(8);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(in + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(in + i + 2));
+        __m128 af = _mm_castsi128_ps(a), bf = _mm_castsi128_ps(b);
+        __m128i lo = _mm_castps_si128(_mm_shuffle_ps(af, bf, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i hi = _mm_castps_si128(_mm_shuffle_ps(af, bf, _MM_SHUFFLE(3, 1, 3, 1)));
+        __m128i h = murmur3_block32_sse42(s, lo);
+        h = murmur3_block32_sse42(h, hi);
+        h = murmur3_fmix32_sse42(_mm_xor_si128(h, len));
+        _mm_storeu_si128((__m128i*)(out + i), h);
+    }
+    return i;
+}
+
+/* ***************************************************
+ * AVX2: 8 keys per vector.
+ * ***************************************************/
+
+__attribute__((target("avx2")))
+static inline __m256i murmur3_rotl32_avx2(__m256i x, int r)
+{
+    return _mm256_or_si256(_mm256_slli_epi32(x, r), _mm256_srli_epi32(x, 32 - r));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i murmur3_block32_avx2(__m256i h, __m256i k)
+{
+    k = _mm256_mullo_epi32(k, _mm256_set1_epi32(murmur3_c1));
+    k = murmur3_rotl32_avx2(k, 15);
+    k = _mm256_mullo_epi32(k, _mm256_set1_epi32(murmur3_c2));
+    h = murmur3_rotl32_avx2(_mm256_xor_si256(h, k), 13);
+    // h*5 = (h << 2) + h
+    h = _mm256_add_epi32(_mm256_add_epi32(_mm256_slli_epi32(h, 2), h), _mm256_set1_epi32(0xe6546b64));
+    return h;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i murmur3_fmix32_avx2(__m256i h)
+{
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32(0x85ebca6b));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32(0xc2b2ae35));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+    return h;
+}
+
+__attribute__((target("avx2")))
+size_t murmur3_32_avx2(uint32_t seed, const uint32_t* in, uint32_t* out, size_t n)
+{
+    const __m256i s = _mm256_set1_epi32(seed);
+    const __m256i len = _mm256_set1_epi32(4);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(in + i));
+        __m256i h = murmur3_block32_avx2(s, x);
+        h = murmur3_fmix32_avx2(_mm256_xor_si256(h, len));
+        _mm256_storeu_si256((__m256i*)(out + i), h);
+    }
+    return i;
+}
+
+// 64-bit keys: the low and high words are split into two vectors.
+__attribute__((target("avx2")))
+size_t murmur3_32_u64_avx2(uint32_t seed, const uint64_t* in, uint32_t* out, size_t n)
+{
+    const __m256i s = _mm256_set1_epi32(seed);
+    const __m256i len = _mm256_set1_epi32(8);
+    const __m256i split = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i a = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)(in + i)), split);
+        __m256i b = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)(in + i + 4)), split);
+        __m256i lo = _mm256_permute2x128_si256(a, b, 0x20);
+        __m256i hi = _mm256_permute2x128_si256(a, b, 0x31);
+        __m256i h = murmur3_block32_avx2(s, lo);
+        h = murmur3_block32_avx2(h, hi);
+        h = murmur3_fmix32_avx2(_mm256_xor_si256(h, len));
+        _mm256_storeu_si256((__m256i*)(out + i), h);
+    }
+    return i;
+}
+
+/* ***************************************************
+ * AVX-512: 16 keys per vector. Same scheme as above
+ * with native rotations.
+ * ***************************************************/
+
+__attribute__((target("avx512f")))
+static inline __m512i murmur3_block32_avx512(__m512i h, __m512i k)
+{
+    k = _mm512_mullo_epi32(k, _mm512_set1_epi32(murmur3_c1));
+    k = _mm512_rol_epi32(k, 15);
+    k = _mm512_mullo_epi32(k, _mm512_set1_epi32(murmur3_c2));
+    h = _mm512_rol_epi32(_mm512_xor_si512(h, k), 13);
+    h = _mm512_add_epi32(_mm512_add_epi32(_mm512_slli_epi32(h, 2), h), _mm512_set1_epi32(0xe6546b64));
+    return h;
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i murmur3_fmix32_avx512(__m512i h)
+{
+    h = _mm512_xor_si512(h, _mm512_srli_epi32(h, 16));
+    h = _mm512_mullo_epi32(h, _mm512_set1_epi32(0x85ebca6b));
+    h = _mm512_xor_si512(h, _mm512_srli_epi32(h, 13));
+    h = _mm512_mullo_epi32(h, _mm512_set1_epi32(0xc2b2ae35));
+    h = _mm512_xor_si512(h, _mm512_srli_epi32(h, 16));
+    return h;
+}
+
+__attribute__((target("avx512f")))
+size_t murmur3_32_avx512(uint32_t seed, const uint32_t* in, uint32_t* out, size_t n)
+{
+    const __m512i s = _mm512_set1_epi32(seed);
+    const __m512i len = _mm512_set1_epi32(4);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i x = _mm512_loadu_si512((const void*)(in + i));
+        __m512i h = murmur3_block32_avx512(s, x);
+        h = murmur3_fmix32_avx512(_mm512_xor_si512(h, len));
+        _mm512_storeu_si512((void*)(out + i), h);
+    }
+    return i;
+}
+
+__attribute__((target("avx512f")))
+size_t murmur3_32_u64_avx512(uint32_t seed, const uint64_t* in, uint32_t* out, size_t n)
+{
+    const __m512i s = _mm512_set1_epi32(seed);
+    const __m512i len = _mm512_set1_epi32(8);
+    const __m512i lo_idx = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    const __m512i hi_idx = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i a = _mm512_loadu_si512((const void*)(in + i));
+        __m512i b = _mm512_loadu_si512((const void*)(in + i + 8));
+        __m512i lo = _mm512_permutex2var_epi32(a, lo_idx, b);
+        __m512i hi = _mm512_permutex2var_epi32(a, hi_idx, b);
+        __m512i h = murmur3_block32_avx512(s, lo);
+        h = murmur3_block32_avx512(h, hi);
+        h = murmur3_fmix32_avx512(_mm512_xor_si512(h, len));
+        _mm512_storeu_si512((void*)(out + i), h);
+    }
+    return i;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // HASHING_X86_SIMD
+
+#endif // _MURMUR_FIXED_H_
@@ -0,0 +1,308 @@
+/* ***********************************************
+ * Hardware performance counters (Linux):
+ * perf_counters opens cycles, instructions, L1D
+ * read misses, last level cache misses and branch
+ * misses for the calling thread and the threads it
+ * creates afterwards, with perf_event_open. Events
+ * the kernel or the machine does not provide (e.g.
+ * in VMs or with perf_event_paranoid > 2) are left
+ * out and reported as unavailable; the task clock
+ * is a software event and nearly always works.
+ *
+ * perf_scope adds the counts of a block of code to
+ * a named phase of perf_phases::global(), e.g.
+ *     {
+ *         perf_scope p("sketching", keys.size());
+ *         ...
+ *     }
+ * and report() prints the totals and the counts
+ * per key of every phase.
+ *
+ * Counting is off unless the environment variable
+ * HASHING_PERF is set, and a scope then only costs
+ * a branch. When it is on, a scope reads every
+ * counter twice with a system call, so scopes
+ * belong around phases, not single keys.
+ * ***********************************************/
+
+#ifndef _PERFCOUNTERS_H_
+#define _PERFCOUNTERS_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <iomanip>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+enum perf_event_id
+{
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_TASK_CLOCK,   // ns the task was running
+    PERF_NUM_EVENTS
+};
+
+const char* perf_event_name(perf_event_id e)
+{
+    static const char* names[PERF_NUM_EVENTS] =
+        { "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses", "task_clock_ns" };
+    return names[e];
+}
+
+// Counter values. valid[e] is false if the event could not be opened.
+struct perf_values
+{
+    double v[PERF_NUM_EVENTS];
+    bool valid[PERF_NUM_EVENTS];
+
+    perf_values()
+    {
+        for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+            v[e] = 0;
+            valid[e] = false;
+        }
+    }
+
+    perf_values& operator+=(const perf_values& o)
+    {
+        for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+            v[e] += o.v[e];
+            valid[e] = valid[e] || o.valid[e];
+        }
+        return *this;
+    }
+};
+
+perf_values operator-(const perf_values& a, const perf_values& b)
+{
+    perf_values d;
+    for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+        d.v[e] = a.v[e] - b.v[e];
+        d.valid[e] = a.valid[e] && b.valid[e];
+    }
+    return d;
+}
+
+class perf_counters
+{
+    int m_fd[PERF_NUM_EVENTS];
+
+    perf_counters(const perf_counters&);
+    perf_counters& operator=(const perf_counters&);
+
+public:
+    perf_counters();
+    ~perf_counters();
+
+    bool available(perf_event_id e) const { return m_fd[e] >= 0; }
+    bool any_available() const;
+    // The counts since the counters were opened. Counts of multiplexed
+    // events are scaled by the fraction of time they were counted.
+    perf_values read() const;
+};
+
+perf_counters::perf_counters()
+{
+    for (int e = 0; e < PERF_NUM_EVENTS; ++e)
+        m_fd[e] = -1;
+#ifdef __linux__
+    static const uint32_t type[PERF_NUM_EVENTS] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE
+    };
+    static const uint64_t config[PERF_NUM_EVENTS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_SW_TASK_CLOCK
+    };
+    for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type[e];
+        attr.config = config[e];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        m_fd[e] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+}
+
+perf_counters::~perf_counters()
+{
+#ifdef __linux__
+    for (int e = 0; e < PERF_NUM_EVENTS; ++e)
+        if (m_fd[e] >= 0)
+            close(m_fd[e]);
+#endif
+}
+
+bool perf_counters::any_available() const
+{
+    for (int e = 0; e < PERF_NUM_EVENTS; ++e)
+        if (available((perf_event_id)e))
+            return true;
+    return false;
+}
+
+perf_values perf_counters::read() const
+{
+    perf_values r;
+#ifdef __linux__
+    for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+        if (m_fd[e] < 0)
+            continue;
+        uint64_t buf[3]; // value, time enabled, time running
+        if (::read(m_fd[e], buf, sizeof(buf)) != (ssize_t)sizeof(buf))
+            continue;
+        r.v[e] = (buf[2] && buf[2] < buf[1]) ? (double)buf[0] * buf[1] / buf[2] : (double)buf[0];
+        r.valid[e] = true;
+    }
+#endif
+    return r;
+}
+
+// Named phases in the order they were first used.
+class perf_phases
+{
+    struct phase
+    {
+        std::string name;
+        uint64_t calls;
+        uint64_t keys;
+        perf_values total;
+    };
+
+    bool m_enabled;
+    perf_counters* m_counters;
+    std::vector<phase> m_phases;
+
+    perf_phases(const perf_phases&);
+    perf_phases& operator=(const perf_phases&);
+
+public:
+    explicit perf_phases(bool enabled);
+    ~perf_phases();
+
+    // Enabled if HASHING_PERF is set in the environment.
+    static perf_phases& global();
+
+    bool enabled() const { return m_enabled; }
+    perf_values read() const { return m_enabled ? m_counters->read() : perf_values(); }
+    void add(const std::string& name, const perf_values& delta, uint64_t keys);
+    void report(std::ostream& out) const;
+};
+
+perf_phases::perf_phases(bool enabled) : m_enabled(enabled), m_counters(NULL)
+{
+    if (m_enabled)
+        m_counters = new perf_counters();
+}
+
+perf_phases::~perf_phases()
+{
+    delete m_counters;
+}
+
+perf_phases& perf_phases::global()
+{
+    static perf_phases phases(getenv("HASHING_PERF") != NULL);
+    return phases;
+}
+
+void perf_phases::add(const std::string& name, const perf_values& delta, uint64_t keys)
+{
+    size_t i = 0;
+    while (i < m_phases.size() && m_phases[i].name != name)
+        ++i;
+    if (i == m_phases.size()) {
+        phase p;
+        p.name = name;
+        p.calls = 0;
+        p.keys = 0;
+        m_phases.push_back(p);
+    }
+    m_phases[i].calls += 1;
+    m_phases[i].keys += keys;
+    m_phases[i].total += delta;
+}
+
+void perf_phases::report(std::ostream& out) const
+{
+    if (!m_enabled)
+        return;
+    out << "Performance counters";
+    const char* sep = " (";
+    for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+        if (!m_counters->available((perf_event_id)e)) {
+            out << sep << perf_event_name((perf_event_id)e) << " n/a";
+            sep = ", ";
+        }
+    }
+    out << (sep[0] == ',' ? ")" : "") << ":" << std::endl;
+    for (size_t i = 0; i < m_phases.size(); ++i) {
+        const phase& p = m_phases[i];
+        out << "  " << p.name << ": " << p.calls << " calls, " << p.keys << " keys" << std::endl;
+        for (int e = 0; e < PERF_NUM_EVENTS; ++e) {
+            if (!p.total.valid[e])
+                continue;
+            out << "    " << std::left << std::setw(15) << perf_event_name((perf_event_id)e) << std::right
+                << std::setw(16) << std::fixed << std::setprecision(0) << p.total.v[e];
+            if (p.keys)
+                out << std::setw(14) << std::setprecision(3) << p.total.v[e] / p.keys << " /key";
+            out << std::endl;
+        }
+        if (p.total.valid[PERF_CYCLES] && p.total.valid[PERF_INSTRUCTIONS] && p.total.v[PERF_CYCLES] > 0)
+            out << "    " << std::left << std::setw(15) << "ipc" << std::right << std::setw(16)
+                << std::setprecision(3) << p.total.v[PERF_INSTRUCTIONS] / p.total.v[PERF_CYCLES] << std::endl;
+    }
+    out.unsetf(std::ios_base::floatfield);
+    out << std::setprecision(6);
+}
+
+// Counts the lifetime of the object as a phase of perf_phases::global().
+// keys is the number of keys processed, for the counts per key.
+class perf_scope
+{
+    std::string m_name;
+    uint64_t m_keys;
+    perf_values m_start;
+
+    perf_scope(const perf_scope&);
+    perf_scope& operator=(const perf_scope&);
+
+public:
+    explicit perf_scope(const std::string& name, uint64_t keys = 0) : m_name(name), m_keys(keys)
+    {
+        if (perf_phases::global().enabled())
+            m_start = perf_phases::global().read();
+    }
+
+    ~perf_scope()
+    {
+        perf_phases& g = perf_phases::global();
+        if (g.enabled())
+            g.add(m_name, g.read() - m_start, m_keys);
+    }
+
+    void set_keys(uint64_t keys) { m_keys = keys; }
+};
+
+#endif // _PERFCOUNTERS_H_
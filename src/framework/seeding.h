@@ -0,0 +1,97 @@
+/* ***********************************************
+ * Seeding of hash functions and sketches:
+ * Every hash function and sketch can be built from
+ * an explicit 64-bit seed. All of its random choices
+ * (coefficients, table entries, densification bits)
+ * are drawn from a counter-based generator keyed by
+ * that seed. Equal seeds give equal hash functions,
+ * and construction costs no system calls.
+ *
+ * The generator is the SplitMix64 output function
+ * applied to key + i * golden ratio, so the i'th
+ * value does not depend on the previous ones and
+ * tables can be filled in bulk.
+ * ***********************************************/
+
+#ifndef _SEEDING_H_
+#define _SEEDING_H_
+
+#include <cstdint>
+#include <cstddef>
+
+// If you have a seed of random bytes (from e.g. random.org) place it in
+// framework/seed/bytes and compile with -DSEED_FROM_FILE to draw all seeds
+// from it instead of from std::random_device.
+#ifdef SEED_FROM_FILE
+#include "seedsource.h"
+#else
+#include <random>
+#endif
+
+// An explicit seed. It is a separate type so that it cannot be confused
+// with the integer parameters of init() and the sketch constructors.
+struct hash_seed
+{
+    uint64_t value;
+    explicit hash_seed(uint64_t v) : value(v) { }
+};
+
+// SplitMix64 finalizer
+inline uint64_t mix64(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+class seed_rng
+{
+    uint64_t m_key;
+    uint64_t m_ctr;
+    static const uint64_t m_gamma = 0x9E3779B97F4A7C15ULL;
+
+public:
+    explicit seed_rng(hash_seed s) : m_key(mix64(s.value)), m_ctr(0) { }
+
+    uint64_t operator()() { return mix64(m_key + (++m_ctr) * m_gamma); }
+    // A seed for a sub-object, e.g. one of the hash functions of a sketch.
+    hash_seed split() { return hash_seed((*this)()); }
+    void fill(uint64_t* out, size_t n);
+    void fill(uint32_t* out, size_t n);
+};
+
+// The values are independent of each other, so this loop has no carried
+// dependency and runs at full multiplier throughput.
+void seed_rng::fill(uint64_t* out, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        out[i] = mix64(m_key + (m_ctr + i + 1) * m_gamma);
+    m_ctr += n;
+}
+
+void seed_rng::fill(uint32_t* out, size_t n)
+{
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        uint64_t v = mix64(m_key + (m_ctr + i/2 + 1) * m_gamma);
+        out[i] = (uint32_t)v;
+        out[i+1] = (uint32_t)(v >> 32);
+    }
+    m_ctr += i/2;
+    if (i < n)
+        out[i] = (uint32_t)(*this)();
+}
+
+// A fresh seed from the system for hash functions that are initialized
+// without one. This is the only place randomness enters from outside.
+hash_seed random_seed()
+{
+#ifdef SEED_FROM_FILE
+    return hash_seed(default_seed_source().next());
+#else
+    std::random_device rd;
+    return hash_seed(((uint64_t)rd() << 32) | rd());
+#endif
+}
+
+#endif // _SEEDING_H_
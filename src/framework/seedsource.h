@@ -0,0 +1,154 @@
+/* ***********************************************
+ * Seeds from a file of random bytes:
+ * seed_source maps the file read-only and hands
+ * out ranges of it through an atomic cursor, so
+ * any number of threads can draw seeds without
+ * locks and without copying the file.
+ *
+ * A thread that constructs many hash functions can
+ * reserve a substream once and draw from it without
+ * touching the shared cursor.
+ *
+ * Every byte is handed out at most once. Drawing
+ * more bytes than the file holds throws.
+ *
+ * Since hash functions expand a 64-bit seed (see
+ * seeding.h), each one uses only 8 bytes, e.g.
+ *     h.init(hash_seed(stream.next()));
+ * The tables of tabulation hashing are then filled
+ * by SplitMix64 from these 8 bytes, not from the
+ * file: the file gives truly random seeds, not
+ * truly random tables. The trade-off keeps files
+ * small and construction cheap.
+ * ***********************************************/
+
+#ifndef _SEEDSOURCE_H_
+#define _SEEDSOURCE_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <ostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+class seed_source;
+
+// A private range of a seed_source. Not thread-safe, use one per thread.
+class seed_stream
+{
+    const unsigned char* m_pos;
+    const unsigned char* m_end;
+
+    friend class seed_source;
+    seed_stream(const unsigned char* begin, const unsigned char* end) : m_pos(begin), m_end(end) { }
+
+public:
+    seed_stream() : m_pos(NULL), m_end(NULL) { }
+
+    uint64_t next();
+    size_t remaining() const { return m_end - m_pos; }
+};
+
+uint64_t seed_stream::next()
+{
+    if (remaining() < sizeof(uint64_t))
+        throw std::runtime_error("seed substream exhausted");
+    uint64_t v;
+    memcpy(&v, m_pos, sizeof(v));
+    m_pos += sizeof(v);
+    return v;
+}
+
+class seed_source
+{
+    const unsigned char* m_data;
+    size_t m_len;
+    std::atomic<size_t> m_used;
+    std::atomic<size_t> m_streams;
+
+    seed_source(const seed_source&);
+    seed_source& operator=(const seed_source&);
+
+public:
+    explicit seed_source(const char* path);
+    ~seed_source();
+
+    // The next bytes of the file. Throws if fewer than n are left.
+    const unsigned char* take(size_t n);
+    uint64_t next();
+    // Reserve n bytes for the calling thread.
+    seed_stream substream(size_t n);
+
+    size_t size() const { return m_len; }
+    size_t used() const { return m_used.load(); }
+    size_t remaining() const { size_t u = used(); return u < m_len ? m_len - u : 0; }
+    void report(std::ostream& out) const;
+};
+
+seed_source::seed_source(const char* path) : m_data(NULL), m_len(0), m_used(0), m_streams(0)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error(std::string("cannot open seed file ") + path);
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            m_data = (const unsigned char*)p;
+            m_len = st.st_size;
+        }
+    }
+    close(fd);
+    if (!m_data)
+        throw std::runtime_error(std::string("cannot map seed file ") + path);
+}
+
+seed_source::~seed_source()
+{
+    munmap((void*)m_data, m_len);
+}
+
+const unsigned char* seed_source::take(size_t n)
+{
+    size_t start = m_used.fetch_add(n);
+    if (start > m_len || n > m_len - start)
+        throw std::runtime_error("seed file exhausted");
+    return m_data + start;
+}
+
+uint64_t seed_source::next()
+{
+    uint64_t v;
+    memcpy(&v, take(sizeof(v)), sizeof(v));
+    return v;
+}
+
+seed_stream seed_source::substream(size_t n)
+{
+    const unsigned char* p = take(n);
+    ++m_streams;
+    return seed_stream(p, p + n);
+}
+
+void seed_source::report(std::ostream& out) const
+{
+    out << "Seed bytes used: " << std::min(used(), m_len) << " of " << m_len
+        << " (" << m_streams.load() << " substreams)" << std::endl;
+}
+
+// The seed file of the repo, opened on first use.
+seed_source& default_seed_source()
+{
+    static seed_source src("framework/seed/bytes");
+    return src;
+}
+
+#endif // _SEEDSOURCE_H_
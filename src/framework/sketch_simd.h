@@ -0,0 +1,263 @@
+/* ***********************************************
+ * SIMD kernels for building the sketches:
+ * The bin mapping of binmap.h for a block of hash
+ * values, the min update of k_partition and the
+ * threshold filter of bottom_k.
+ *
+ * The min update gathers the current minimum of
+ * the bins of a vector of values and compares.
+ * Once the sketch has filled up almost no value is
+ * below its bin minimum, and the few that are are
+ * applied one at a time in input order. Values of
+ * one vector that share a bin thus cannot get in
+ * each other's way, and the result is the same as
+ * with the scalar loop.
+ *
+ * The filter copies the values of a block that are
+ * at most a threshold, in order. Once bottom_k has
+ * seen a few times k values almost none pass, and
+ * the AVX-512 kernel compress-stores them.
+ *
+ * As in hashing_simd.h the kernels process the
+ * largest prefix that fills whole vectors, return
+ * its length and must only be called if
+ * cpu_simd_level() reports support.
+ * ***********************************************/
+
+#ifndef _SKETCH_SIMD_H_
+#define _SKETCH_SIMD_H_
+
+#include <cstdint>
+#include <cstddef>
+
+#include "cpufeatures.h"
+#include "hashing_simd.h"
+
+#ifdef HASHING_X86_SIMD
+
+#include <immintrin.h>
+
+// See hashing_simd.h: GCC 12's AVX-512 intrinsics trip -Wmaybe-uninitialized.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+/* ***************************************************
+ * AVX2: 8 values per vector
+ * ***************************************************/
+
+// floor(M*x / 2^64) for x < 2^32 in the low word of each lane.
+__attribute__((target("avx2")))
+static inline __m256i mulhi64_avx2(__m256i x, __m256i mlo, __m256i mhi)
+{
+    __m256i lo = _mm256_srli_epi64(_mm256_mul_epu32(x, mlo), 32);
+    return _mm256_srli_epi64(_mm256_add_epi64(_mm256_mul_epu32(x, mhi), lo), 32);
+}
+
+// bin_div: rank = h / k by the reciprocal M, bin = h - rank*k. one is all
+// ones for k = 1.
+__attribute__((target("avx2")))
+size_t bin_div_split_avx2(uint64_t M, uint32_t k, uint32_t one, const uint32_t* in,
+                          uint32_t* bin, uint32_t* rank, size_t n)
+{
+    const __m256i mlo = _mm256_set1_epi64x(M & 0xFFFFFFFF);
+    const __m256i mhi = _mm256_set1_epi64x(M >> 32);
+    const __m256i vk = _mm256_set1_epi32(k);
+    const __m256i vone = _mm256_set1_epi32(one);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i h = _mm256_loadu_si256((const __m256i*)(in + i));
+        __m256i re = mulhi64_avx2(h, mlo, mhi);
+        __m256i ro = mulhi64_avx2(_mm256_srli_epi64(h, 32), mlo, mhi);
+        __m256i r = _mm256_add_epi32(merge_lanes_avx2(re, ro), _mm256_and_si256(h, vone));
+        __m256i b = _mm256_sub_epi32(h, _mm256_mullo_epi32(r, vk));
+        _mm256_storeu_si256((__m256i*)(rank + i), r);
+        _mm256_storeu_si256((__m256i*)(bin + i), b);
+    }
+    return i;
+}
+
+// bin_range: bin = (h*k) >> 32, rank = h - start[bin].
+__attribute__((target("avx2")))
+size_t bin_range_split_avx2(uint32_t k, const uint32_t* start, const uint32_t* in,
+                            uint32_t* bin, uint32_t* rank, size_t n)
+{
+    const __m256i vk = _mm256_set1_epi64x(k);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i h = _mm256_loadu_si256((const __m256i*)(in + i));
+        __m256i be = _mm256_srli_epi64(_mm256_mul_epu32(h, vk), 32);
+        __m256i bo = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(h, 32), vk), 32);
+        __m256i b = merge_lanes_avx2(be, bo);
+        __m256i s = _mm256_i32gather_epi32((const int*)start, b, 4);
+        _mm256_storeu_si256((__m256i*)(rank + i), _mm256_sub_epi32(h, s));
+        _mm256_storeu_si256((__m256i*)(bin + i), b);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t sketch_min_update_avx2(uint32_t* out, const uint32_t* bin, const uint32_t* val, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i b = _mm256_loadu_si256((const __m256i*)(bin + i));
+        __m256i v = _mm256_loadu_si256((const __m256i*)(val + i));
+        __m256i cur = _mm256_i32gather_epi32((const int*)out, b, 4);
+        // v < cur unsigned: min(v, cur) != cur
+        __m256i keep = _mm256_cmpeq_epi32(_mm256_min_epu32(v, cur), cur);
+        uint32_t m = ~_mm256_movemask_ps(_mm256_castsi256_ps(keep)) & 0xFF;
+        while (m) {
+            size_t j = i + __builtin_ctz(m);
+            m &= m - 1;
+            if (val[j] < out[bin[j]])
+                out[bin[j]] = val[j];
+        }
+    }
+    return i;
+}
+
+// Copy the values <= thr to out + m and advance m.
+__attribute__((target("avx2")))
+size_t filter_le_avx2(const uint32_t* in, size_t n, uint32_t thr, uint32_t* out, size_t& m)
+{
+    const __m256i vt = _mm256_set1_epi32(thr);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(in + i));
+        __m256i le = _mm256_cmpeq_epi32(_mm256_min_epu32(v, vt), v);
+        uint32_t mask = _mm256_movemask_ps(_mm256_castsi256_ps(le));
+        while (mask) {
+            out[m++] = in[i + __builtin_ctz(mask)];
+            mask &= mask - 1;
+        }
+    }
+    return i;
+}
+
+/* ***************************************************
+ * AVX-512: 16 values per vector
+ * ***************************************************/
+
+__attribute__((target("avx512f")))
+static inline __m512i mulhi64_avx512(__m512i x, __m512i mlo, __m512i mhi)
+{
+    __m512i lo = _mm512_srli_epi64(_mm512_mul_epu32(x, mlo), 32);
+    return _mm512_srli_epi64(_mm512_add_epi64(_mm512_mul_epu32(x, mhi), lo), 32);
+}
+
+__attribute__((target("avx512f")))
+size_t bin_div_split_avx512(uint64_t M, uint32_t k, uint32_t one, const uint32_t* in,
+                            uint32_t* bin, uint32_t* rank, size_t n)
+{
+    const __m512i mlo = _mm512_set1_epi64(M & 0xFFFFFFFF);
+    const __m512i mhi = _mm512_set1_epi64(M >> 32);
+    const __m512i vk = _mm512_set1_epi32(k);
+    const __m512i vone = _mm512_set1_epi32(one);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i h = _mm512_loadu_si512((const void*)(in + i));
+        __m512i re = mulhi64_avx512(h, mlo, mhi);
+        __m512i ro = mulhi64_avx512(_mm512_srli_epi64(h, 32), mlo, mhi);
+        __m512i r = _mm512_add_epi32(merge_lanes_avx512(re, ro), _mm512_and_si512(h, vone));
+        __m512i b = _mm512_sub_epi32(h, _mm512_mullo_epi32(r, vk));
+        _mm512_storeu_si512((void*)(rank + i), r);
+        _mm512_storeu_si512((void*)(bin + i), b);
+    }
+    return i;
+}
+
+__attribute__((target("avx512f")))
+size_t bin_range_split_avx512(uint32_t k, const uint32_t* start, const uint32_t* in,
+                              uint32_t* bin, uint32_t* rank, size_t n)
+{
+    const __m512i vk = _mm512_set1_epi64(k);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i h = _mm512_loadu_si512((const void*)(in + i));
+        __m512i be = _mm512_srli_epi64(_mm512_mul_epu32(h, vk), 32);
+        __m512i bo = _mm512_srli_epi64(_mm512_mul_epu32(_mm512_srli_epi64(h, 32), vk), 32);
+        __m512i b = merge_lanes_avx512(be, bo);
+        __m512i s = _mm512_i32gather_epi32(b, (const void*)start, 4);
+        _mm512_storeu_si512((void*)(rank + i), _mm512_sub_epi32(h, s));
+        _mm512_storeu_si512((void*)(bin + i), b);
+    }
+    return i;
+}
+
+__attribute__((target("avx512f")))
+size_t sketch_min_update_avx512(uint32_t* out, const uint32_t* bin, const uint32_t* val, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i b = _mm512_loadu_si512((const void*)(bin + i));
+        __m512i v = _mm512_loadu_si512((const void*)(val + i));
+        __m512i cur = _mm512_i32gather_epi32(b, (const void*)out, 4);
+        uint32_t m = _mm512_cmplt_epu32_mask(v, cur);
+        while (m) {
+            size_t j = i + __builtin_ctz(m);
+            m &= m - 1;
+            if (val[j] < out[bin[j]])
+                out[bin[j]] = val[j];
+        }
+    }
+    return i;
+}
+
+__attribute__((target("avx512f")))
+size_t filter_le_avx512(const uint32_t* in, size_t n, uint32_t thr, uint32_t* out, size_t& m)
+{
+    const __m512i vt = _mm512_set1_epi32(thr);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i v = _mm512_loadu_si512((const void*)(in + i));
+        __mmask16 mask = _mm512_cmple_epu32_mask(v, vt);
+        _mm512_mask_compressstoreu_epi32((void*)(out + m), mask, v);
+        m += __builtin_popcount(mask);
+    }
+    return i;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // HASHING_X86_SIMD
+
+// output[bin[i]] = min(output[bin[i]], val[i]) for all i < n.
+void sketch_min_update(uint32_t* out, const uint32_t* bin, const uint32_t* val, size_t n)
+{
+    size_t i = 0;
+#ifdef HASHING_X86_SIMD
+    simd_level lvl = cpu_simd_level();
+    if (lvl == SIMD_AVX512)
+        i = sketch_min_update_avx512(out, bin, val, n);
+    else if (lvl == SIMD_AVX2)
+        i = sketch_min_update_avx2(out, bin, val, n);
+#endif
+    for (; i < n; ++i)
+        if (val[i] < out[bin[i]])
+            out[bin[i]] = val[i];
+}
+
+// Copy the values of in[0, n) that are <= thr to out, in order, and return
+// their number. out must have room for n values.
+size_t filter_le(const uint32_t* in, size_t n, uint32_t thr, uint32_t* out)
+{
+    size_t i = 0, m = 0;
+#ifdef HASHING_X86_SIMD
+    simd_level lvl = cpu_simd_level();
+    if (lvl == SIMD_AVX512)
+        i = filter_le_avx512(in, n, thr, out, m);
+    else if (lvl == SIMD_AVX2)
+        i = filter_le_avx2(in, n, thr, out, m);
+#endif
+    for (; i < n; ++i) {
+        out[m] = in[i];
+        m += (in[i] <= thr);
+    }
+    return m;
+}
+
+#endif // _SKETCH_SIMD_H_
@@ -9,146 +9,230 @@
 #include <cstdint>
 #include <limits>
 #include <cassert>
-#include <queue>
-
-// TODO: If you have a file with random bytes from e.g. random.org, place it
-// in the seed folder and use randomgen.h instead.
-#include <random>  // TODO: Replace with #include "randomgen.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <functional>
+
+// Sketches constructed without a seed draw one with random_seed(). See
+// seeding.h on how to use a file of random bytes instead.
+#include "seeding.h"
 #include "hashing.h"
+#include "state.h"
+#include "binmap.h"
+#include "densify.h"
+#include "csr.h"
+#include "threadpool.h"
 
 
 using namespace std;
 
+// Number of keys handed to a hash function per hash_many call. The buffers
+// live on the stack, so keep this small enough to stay in L1.
+const size_t SKETCH_BLOCK = 256;
+
+
+template <class F, class Bins, class Dens> class k_partition_state;
+template <class F> class bottom_k_state;
 
 /* *******************************************************
  * k-partition a la one permutation of Li et al.
+ * Bins maps a hash value to the bin and the rank in the
+ * bin, see binmap.h. Dens fills the empty bins, see
+ * densify.h.
  * *******************************************************/
 
-template <class F>
+template <class F, class Bins = bin_div, class Dens = densify_leftright>
 class k_partition
 {
+    public:
+    // Keys of the input sets, the key type of the hash function.
+    typedef typename F::key_type key_type;
+
+    private:
     uint32_t m_k;
-    vector<uint32_t> m_copy; // Shrivastava&Li left/right densification
+    Bins m_bins;
+    Dens m_dens;
 
     F h; // The hash function to be used.
 
-    void sketch_core(const vector<uint32_t>& input, vector<uint32_t>& output);
+    friend class k_partition_state<F, Bins, Dens>;
+
+    void sketch_core(const key_type* input, size_t n, uint32_t* output) const;
+    // Lower the bins of output to the keys of input, without densifying.
+    void sketch_update(const key_type* input, size_t n, uint32_t* output) const;
+    void sketch_core(const key_type* input, size_t n, uint32_t* output, false_type) const;
+    void sketch_core(const key_type* input, size_t n, uint32_t* output, true_type) const;
+    // The densified sketch of n keys in output[0, k).
+    void sketch_row(const key_type* input, size_t n, uint32_t* output) const;
 
     public:
     k_partition();
     k_partition(uint32_t k);
     k_partition(uint32_t k, uint32_t hparam);
+    k_partition(uint32_t k, hash_seed seed);
+    k_partition(uint32_t k, uint32_t hparam, hash_seed seed);
+
+    // The state holds k, the densification state and the hash function.
+    void save(state_writer& out) const;
+    void load(state_reader& in);
 
-    void sketch(const vector<uint32_t>& input, vector<uint32_t>& output);
-    void bbit_sketch(const vector<uint32_t>& input, vector<uint32_t>& output, uint32_t b);
+    void sketch(const vector<key_type>& input, vector<uint32_t>& output);
+    // Sketch set i of sets into row i of output, a sets.size() x k matrix in
+    // row-major order, on the threads of pool.
+    void sketch_batch(const csr_sets<key_type>& sets, vector<uint32_t>& output,
+                      thread_pool& pool = thread_pool::global());
+    void bbit_sketch(const vector<key_type>& input, vector<uint32_t>& output, uint32_t b);
 
     double estimate(const vector<uint32_t>& A, const vector<uint32_t>& B);
 
 };
 
-template <class F>
-k_partition<F>::k_partition()
+template <class F, class Bins, class Dens>
+k_partition<F, Bins, Dens>::k_partition() : k_partition(200) // default value
 {
-    k_partition(200); // default value
 }
 
-template <class F>
-k_partition<F>::k_partition(uint32_t k)
+template <class F, class Bins, class Dens>
+k_partition<F, Bins, Dens>::k_partition(uint32_t k) : k_partition(k, random_seed())
 {
-    // TODO: Remove below 3 lines if using randomgen.h
-    mt19937 rng;
-    rng.seed(random_device()());
-    uniform_int_distribution<uint32_t> dist(0,1);
+}
 
+template <class F, class Bins, class Dens>
+k_partition<F, Bins, Dens>::k_partition(uint32_t k, uint32_t hparam) : k_partition(k, hparam, random_seed())
+{
+}
+
+template <class F, class Bins, class Dens>
+k_partition<F, Bins, Dens>::k_partition(uint32_t k, hash_seed seed)
+{
+    seed_rng rng(seed);
     m_k = k;
-    m_copy.resize(m_k, 0);
-    for (int i = 0; i < m_k; ++i)
-        m_copy[i] = dist(rng);
-        // TODO: Replace with line below if using randomgen.h
-        //m_copy[i] = getRandomBool();
+    m_bins.init(k);
+    m_dens.init(k, rng);
 
-    h.init(); // Initialize the hash function
+    h.init(rng.split()); // Initialize the hash function
 }
 
-template <class F>
-k_partition<F>::k_partition(uint32_t k, uint32_t hparam)
+template <class F, class Bins, class Dens>
+k_partition<F, Bins, Dens>::k_partition(uint32_t k, uint32_t hparam, hash_seed seed)
 {
-    // TODO: Remove below 3 lines if using randomgen.h
-    mt19937 rng;
-    rng.seed(random_device()());
-    uniform_int_distribution<uint32_t> dist(0,1);
-
+    seed_rng rng(seed);
     m_k = k;
-    m_copy.resize(m_k, 0);
-    for (int i = 0; i < m_k; ++i)
-        m_copy[i] = dist(rng);
-        // TODO: Replace with line below if using randomgen.h
-        //m_copy[i] = getRandomBool();
+    m_bins.init(k);
+    m_dens.init(k, rng);
 
-    h.init(hparam); // Initialize the hash function
+    h.init(hparam, rng.split()); // Initialize the hash function
+}
+
+template <class F, class Bins, class Dens>
+void k_partition<F, Bins, Dens>::save(state_writer& out) const
+{
+    out.tag("k_partition");
+    out.tag(Bins::name());
+    out.tag(Dens::name());
+    out.put(m_k);
+    m_dens.save(out);
+    h.save(out);
+}
+
+template <class F, class Bins, class Dens>
+void k_partition<F, Bins, Dens>::load(state_reader& in)
+{
+    in.tag("k_partition");
+    in.tag(Bins::name());
+    in.tag(Dens::name());
+    in.get(m_k);
+    if (m_k == 0)
+        throw state_error("bad k_partition size");
+    m_bins.init(m_k);
+    m_dens.load(in, m_k);
+    h.load(in);
 }
 
 // The actual k-partition part.
-template <class F>
-void k_partition<F>::sketch_core(const vector<uint32_t>& input, vector<uint32_t>& output)
+template <class F, class Bins, class Dens>
+void k_partition<F, Bins, Dens>::sketch_core(const key_type* input, size_t n, uint32_t* output) const
 {
-    output.resize(m_k, -1); // Prepare k-partition sketch (initialize to max)
+    fill(output, output + m_k, (uint32_t)-1); // Prepare k-partition sketch (initialize to max)
     // Note that -1 = max value is too large to be an actual value
-    for (auto it = input.begin(); it != input.end(); ++it) {
-        uint32_t v = h(*it);
-        uint32_t bin = v % m_k;
-        uint32_t val = v / m_k;
-        output[bin] = min(output[bin],val);
-    }
+    sketch_update(input, n, output);
 }
 
-// Call the core and do densification
-template <class F>
-void k_partition<F>::sketch(const vector<uint32_t>& input, vector<uint32_t>& output)
+template <class F, class Bins, class Dens>
+void k_partition<F, Bins, Dens>::sketch_update(const key_type* input, size_t n, uint32_t* output) const
 {
-    sketch_core(input, output);
-
-    uint32_t thr = numeric_limits<uint32_t>::max() / m_k + 1;
+    sketch_core(input, n, output, integral_constant<bool, (hash_outputs<F>::value > 1)>());
+}
 
-    uint32_t sl, sr;
-    uint32_t jl = 0, jr = 0;
-    for (int i = m_k-1; i >= 0; --i) {
-        ++jl;
-        if (output[i] < thr) {
-            sl = output[i];
-            break;
-        }
-    }
-    for (int i = 0; i < m_k; ++i) {
-        ++jr;
-        if (output[i] < thr) {
-            sr = output[i];
-            break;
-        }
+// Bin and value are split from one 32-bit hash value. Each block is
+// hashed, split and merged into the sketch in three batched steps, see
+// sketch_simd.h for the min update.
+template <class F, class Bins, class Dens>
+void k_partition<F, Bins, Dens>::sketch_core(const key_type* input, size_t n, uint32_t* output, false_type) const
+{
+    uint32_t hv[SKETCH_BLOCK], bins[SKETCH_BLOCK], vals[SKETCH_BLOCK];
+    for (size_t i = 0; i < n; i += SKETCH_BLOCK) {
+        size_t len = min(SKETCH_BLOCK, n - i);
+        h.hash_many(input + i, hv, len);
+        m_bins.split_many(hv, bins, vals, len);
+        sketch_min_update(output, bins, vals, len);
     }
+}
 
-    for (int i = 0; i < m_k; ++i) {
-        ++jl;
-        if (output[i] < thr) {
-            sl = output[i];
-            jl = 0;
-        }
-        if (output[i] >= thr && m_copy[i] == 0)
-            output[i] = sl + jl*thr;
-    }
-    for (int i = m_k-1; i >= 0; --i) {
-        ++jr;
-        if (output[i] < thr) {
-            sr = output[i];
-            jr = 0;
+// Bin and value come from two independent hash values of one evaluation.
+// The value is the full 32-bit second output, lowered to max - 1 so max
+// still marks an empty bin, and the estimate compares full-width values:
+// two different keys give a false match with probability about 2^-32
+// instead of k/2^32. Filled bins can then equal real values, see densify.h.
+template <class F, class Bins, class Dens>
+void k_partition<F, Bins, Dens>::sketch_core(const key_type* input, size_t n, uint32_t* output, true_type) const
+{
+    const uint32_t o = hash_outputs<F>::value;
+    const uint32_t top = numeric_limits<uint32_t>::max() - 1;
+    uint32_t hv[SKETCH_BLOCK * o], bins[SKETCH_BLOCK], vals[SKETCH_BLOCK];
+    for (size_t i = 0; i < n; i += SKETCH_BLOCK) {
+        size_t len = min(SKETCH_BLOCK, n - i);
+        h.hash_many_wide(input + i, hv, len);
+        for (size_t j = 0; j < len; ++j) {
+            bins[j] = m_bins.bin(hv[j*o]);
+            vals[j] = min(hv[j*o + 1], top);
         }
-        if (output[i] >= thr && m_copy[i] == 1)
-            output[i] = sr + jr * thr;
+        sketch_min_update(output, bins, vals, len);
     }
 }
 
-template <class F>
-void k_partition<F>::bbit_sketch(const vector<uint32_t>&input, vector<uint32_t>& output, uint32_t b)
+// Call the core and do densification
+template <class F, class Bins, class Dens>
+void k_partition<F, Bins, Dens>::sketch_row(const key_type* input, size_t n, uint32_t* output) const
+{
+    sketch_core(input, n, output);
+    m_dens.densify(output, m_k);
+}
+
+template <class F, class Bins, class Dens>
+void k_partition<F, Bins, Dens>::sketch(const vector<key_type>& input, vector<uint32_t>& output)
+{
+    output.resize(m_k);
+    sketch_row(input.data(), input.size(), &output[0]);
+}
+
+// The rows are independent and the sketching is const, so the threads share
+// the sketch and need no scratch space beyond the stack buffers of the core.
+template <class F, class Bins, class Dens>
+void k_partition<F, Bins, Dens>::sketch_batch(const csr_sets<key_type>& sets, vector<uint32_t>& output,
+                                              thread_pool& pool)
+{
+    output.resize(sets.size() * m_k);
+    pool.parallel_for(sets.size(), [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; ++i)
+            sketch_row(sets.set(i), sets.set_size(i), &output[i * m_k]);
+    });
+}
+
+template <class F, class Bins, class Dens>
+void k_partition<F, Bins, Dens>::bbit_sketch(const vector<key_type>&input, vector<uint32_t>& output, uint32_t b)
 {
     sketch(input, output);
 
@@ -157,8 +241,8 @@ void k_partition<F>::bbit_sketch(const vector<uint32_t>&input, vector<uint32_t>&
         *it &= mask;
 }
 
-template <class F>
-double k_partition<F>::estimate(const vector<uint32_t>& A, const vector<uint32_t>& B)
+template <class F, class Bins, class Dens>
+double k_partition<F, Bins, Dens>::estimate(const vector<uint32_t>& A, const vector<uint32_t>& B)
 {
     assert(A.size() == B.size());
     assert(A.size() == m_k);
@@ -169,67 +253,277 @@ double k_partition<F>::estimate(const vector<uint32_t>& A, const vector<uint32_t
     return (double)match/(double)m_k;
 }
 
+/* *******************************************************
+ * A k-partition sketch built in parts: The bins are kept
+ * undensified, so keys can be inserted and the sketches
+ * of several parts of a set merged by taking the minimum
+ * of each bin. finalize() densifies a copy, which is kept
+ * until the next change.
+ *
+ * Merged states must come from k_partitions with the same
+ * seed, e.g. the same object or one loaded from its saved
+ * state, and then give exactly the sketch of the union.
+ * *******************************************************/
+
+template <class F, class Bins = bin_div, class Dens = densify_leftright>
+class k_partition_state
+{
+    public:
+    typedef typename F::key_type key_type;
+
+    private:
+    const k_partition<F, Bins, Dens>* m_sketch;
+    vector<uint32_t> m_bins;  // Undensified, max for empty bins
+    vector<uint32_t> m_final; // Densified copy of m_bins if m_valid
+    bool m_valid;
+
+    public:
+    // The state of the empty set.
+    explicit k_partition_state(const k_partition<F, Bins, Dens>& sketch);
+    // A state from undensified bins, e.g. bins() of a state of another process.
+    k_partition_state(const k_partition<F, Bins, Dens>& sketch, const vector<uint32_t>& bins);
+
+    void insert(key_type x);
+    void insert(const vector<key_type>& input);
+    void merge(const k_partition_state& other);
+    void clear();
+
+    const vector<uint32_t>& bins() const { return m_bins; }
+    // The densified sketch, equal to sketch() of all inserted keys.
+    const vector<uint32_t>& finalize();
+};
+
+template <class F, class Bins, class Dens>
+k_partition_state<F, Bins, Dens>::k_partition_state(const k_partition<F, Bins, Dens>& sketch)
+    : m_sketch(&sketch), m_bins(sketch.m_k, -1), m_valid(false)
+{
+}
+
+template <class F, class Bins, class Dens>
+k_partition_state<F, Bins, Dens>::k_partition_state(const k_partition<F, Bins, Dens>& sketch,
+                                                    const vector<uint32_t>& bins)
+    : m_sketch(&sketch), m_bins(bins), m_valid(false)
+{
+    if (bins.size() != sketch.m_k)
+        throw invalid_argument("k_partition_state: bins do not match k");
+}
+
+template <class F, class Bins, class Dens>
+void k_partition_state<F, Bins, Dens>::insert(key_type x)
+{
+    m_sketch->sketch_update(&x, 1, &m_bins[0]);
+    m_valid = false;
+}
+
+template <class F, class Bins, class Dens>
+void k_partition_state<F, Bins, Dens>::insert(const vector<key_type>& input)
+{
+    m_sketch->sketch_update(input.data(), input.size(), &m_bins[0]);
+    m_valid = false;
+}
+
+template <class F, class Bins, class Dens>
+void k_partition_state<F, Bins, Dens>::merge(const k_partition_state& other)
+{
+    assert(other.m_bins.size() == m_bins.size());
+    for (size_t i = 0; i < m_bins.size(); ++i)
+        m_bins[i] = min(m_bins[i], other.m_bins[i]);
+    m_valid = false;
+}
+
+template <class F, class Bins, class Dens>
+void k_partition_state<F, Bins, Dens>::clear()
+{
+    fill(m_bins.begin(), m_bins.end(), (uint32_t)-1);
+    m_valid = false;
+}
+
+template <class F, class Bins, class Dens>
+const vector<uint32_t>& k_partition_state<F, Bins, Dens>::finalize()
+{
+    if (!m_valid) {
+        m_final = m_bins;
+        m_sketch->m_dens.densify(&m_final[0], m_sketch->m_k);
+        m_valid = true;
+    }
+    return m_final;
+}
+
 /* *******************************************************************
  * Feature hashing (Weinberger et al.) -- similar to countsketch
  * Inputs to this sketch are high-dimensional vectors represented as
- * (index, value)-pairs.
+ * (index, value)-pairs. Bins maps a hash value to the bin, see binmap.h.
  * *******************************************************************/
 
-template <class F>
+template <class F, class Bins = bin_div>
 class f_hash
 {
+    public:
+    // Keys of the input sets, the key type of the hash function.
+    typedef typename F::key_type key_type;
+
+    private:
     uint32_t m_d;
+    Bins m_bins;
 
     F h1;
-    F h2; // The hash functions to be used.
+    F h2; // The hash functions to be used. h2 is unused if h1 gives 2+ values.
+
+    void sketch_core(const pair<key_type,double>* input, size_t n, double* output, false_type) const;
+    void sketch_core(const pair<key_type,double>* input, size_t n, double* output, true_type) const;
+    // The sketch of n entries in output[0, d).
+    void sketch_row(const pair<key_type,double>* input, size_t n, double* output) const;
 
     public:
     f_hash();
     f_hash(uint32_t d);
     f_hash(uint32_t d, uint32_t hparam);
+    f_hash(uint32_t d, hash_seed seed);
+    f_hash(uint32_t d, uint32_t hparam, hash_seed seed);
+
+    void save(state_writer& out) const;
+    void load(state_reader& in);
 
-    void sketch(const vector<pair<uint32_t,double>>& input, vector<double>& output);
+    void sketch(const vector<pair<key_type,double>>& input, vector<double>& output);
+    // Sketch vector i of sets into row i of output, a sets.size() x d matrix
+    // in row-major order, on the threads of pool.
+    void sketch_batch(const csr_sets<pair<key_type,double>>& sets, vector<double>& output,
+                      thread_pool& pool = thread_pool::global());
     double dotprod(const vector<double>& A, const vector<double>& B);
 };
 
-template <class F>
-f_hash<F>::f_hash()
+template <class F, class Bins>
+f_hash<F, Bins>::f_hash() : f_hash(100)
 {
-    f_hash(100);
 }
 
-template <class F>
-f_hash<F>::f_hash(uint32_t d)
+template <class F, class Bins>
+f_hash<F, Bins>::f_hash(uint32_t d) : f_hash(d, random_seed())
+{
+}
+
+template <class F, class Bins>
+f_hash<F, Bins>::f_hash(uint32_t d, uint32_t hparam) : f_hash(d, hparam, random_seed())
 {
+}
+
+template <class F, class Bins>
+f_hash<F, Bins>::f_hash(uint32_t d, hash_seed seed)
+{
+    seed_rng rng(seed);
     m_d = d;
-    h1.init();
-    h2.init();
+    m_bins.init(d);
+    h1.init(rng.split());
+    if (hash_outputs<F>::value == 1)
+        h2.init(rng.split());
 }
 
-template <class F>
-f_hash<F>::f_hash(uint32_t d, uint32_t hparam)
+template <class F, class Bins>
+f_hash<F, Bins>::f_hash(uint32_t d, uint32_t hparam, hash_seed seed)
 {
+    seed_rng rng(seed);
     m_d = d;
-    h1.init(hparam);
-    h2.init(hparam);
+    m_bins.init(d);
+    h1.init(hparam, rng.split());
+    if (hash_outputs<F>::value == 1)
+        h2.init(hparam, rng.split());
 }
 
-template <class F>
-void f_hash<F>::sketch(const vector<pair<uint32_t,double>>&input, vector<double>& output)
+template <class F, class Bins>
+void f_hash<F, Bins>::save(state_writer& out) const
+{
+    out.tag("f_hash");
+    out.tag(Bins::name());
+    out.put(m_d);
+    h1.save(out);
+    if (hash_outputs<F>::value == 1)
+        h2.save(out);
+}
+
+template <class F, class Bins>
+void f_hash<F, Bins>::load(state_reader& in)
+{
+    in.tag("f_hash");
+    in.tag(Bins::name());
+    in.get(m_d);
+    if (m_d == 0)
+        throw state_error("bad f_hash size");
+    m_bins.init(m_d);
+    h1.load(in);
+    if (hash_outputs<F>::value == 1)
+        h2.load(in);
+}
+
+template <class F, class Bins>
+void f_hash<F, Bins>::sketch_row(const pair<key_type,double>* input, size_t n, double* output) const
 {
     // We assumption is that the input is a set (i.e. no weighted elements!)
-    output.resize(m_d,0.0);
-    for (auto it = input.begin(); it != input.end(); ++it) {
-        uint32_t idx = it->first;
-        double val = it->second;
-        uint32_t bin = h1(idx) % m_d;
-        int32_t sgn = h2(idx) % 2;
-        output[bin] += (double)(sgn*2 - 1) * val; // {0,1} -> {-1,1}
+    fill(output, output + m_d, 0.0);
+    sketch_core(input, n, output, integral_constant<bool, (hash_outputs<F>::value > 1)>());
+}
+
+template <class F, class Bins>
+void f_hash<F, Bins>::sketch(const vector<pair<key_type,double>>&input, vector<double>& output)
+{
+    output.resize(m_d);
+    sketch_row(input.data(), input.size(), &output[0]);
+}
+
+template <class F, class Bins>
+void f_hash<F, Bins>::sketch_batch(const csr_sets<pair<key_type,double>>& sets, vector<double>& output,
+                                   thread_pool& pool)
+{
+    output.resize(sets.size() * m_d);
+    pool.parallel_for(sets.size(), [&](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; ++i)
+            sketch_row(sets.set(i), sets.set_size(i), &output[i * m_d]);
+    });
+}
+
+// Bin and sign from two separate hash functions.
+template <class F, class Bins>
+void f_hash<F, Bins>::sketch_core(const pair<key_type,double>* input, size_t n, double* output, false_type) const
+{
+    key_type idx[SKETCH_BLOCK];
+    uint32_t hb[SKETCH_BLOCK], hs[SKETCH_BLOCK];
+    for (size_t i = 0; i < n; i += SKETCH_BLOCK) {
+        size_t len = min(SKETCH_BLOCK, n - i);
+        for (size_t j = 0; j < len; ++j)
+            idx[j] = input[i+j].first;
+        h1.hash_many(idx, hb, len);
+        h2.hash_many(idx, hs, len);
+        for (size_t j = 0; j < len; ++j) {
+            double val = input[i+j].second;
+            uint32_t bin = m_bins.bin(hb[j]);
+            int32_t sgn = hs[j] & 1;
+            output[bin] += (double)(sgn*2 - 1) * val; // {0,1} -> {-1,1}
+        }
     }
 }
 
-template <class F>
-double f_hash<F>::dotprod(const vector<double>& A, const vector<double>& B)
+// Bin and sign from two independent values of a single evaluation of h1.
+template <class F, class Bins>
+void f_hash<F, Bins>::sketch_core(const pair<key_type,double>* input, size_t n, double* output, true_type) const
+{
+    const uint32_t o = hash_outputs<F>::value;
+    key_type idx[SKETCH_BLOCK];
+    uint32_t hv[SKETCH_BLOCK * o];
+    for (size_t i = 0; i < n; i += SKETCH_BLOCK) {
+        size_t len = min(SKETCH_BLOCK, n - i);
+        for (size_t j = 0; j < len; ++j)
+            idx[j] = input[i+j].first;
+        h1.hash_many_wide(idx, hv, len);
+        for (size_t j = 0; j < len; ++j) {
+            double val = input[i+j].second;
+            uint32_t bin = m_bins.bin(hv[j*o]);
+            int32_t sgn = hv[j*o + 1] & 1;
+            output[bin] += (double)(sgn*2 - 1) * val; // {0,1} -> {-1,1}
+        }
+    }
+}
+
+template <class F, class Bins>
+double f_hash<F, Bins>::dotprod(const vector<double>& A, const vector<double>& B)
 {
     assert(A.size() == B.size());
     assert(A.size() == m_d);
@@ -242,90 +536,277 @@ double f_hash<F>::dotprod(const vector<double>& A, const vector<double>& B)
 
 /* *******************************************************************
  * Bottom-k hashing
+ * The sketch is the k smallest distinct hash values in sorted order, or
+ * all of them for sets with fewer than k. Repeated keys and keys with
+ * equal hash values count once, so sketches of overlapping parts of a
+ * set can be merged (see bottom_k_state). Hash values are filtered
+ * against the current k'th smallest, and the values that pass are
+ * buffered and cut back to the k smallest distinct ones whenever the
+ * buffer holds 2k, so most values cost one compare.
  * *******************************************************************/
 
 template <class F>
 class bottom_k
 {
+    public:
+    // Keys of the input sets, the key type of the hash function.
+    typedef typename F::key_type key_type;
+
+    private:
     uint32_t m_k;
 
     F h; // The hash function to be used.
 
+    friend class bottom_k_state<F>;
+
+    // The sketch of n keys in output[0, m) for m = min(k, distinct hash
+    // values), which is returned. buf is scratch space.
+    size_t sketch_row(const key_type* input, size_t n, uint32_t* output, vector<uint32_t>& buf) const;
+
     public:
     bottom_k();
     bottom_k(uint32_t k);
+    bottom_k(uint32_t k, hash_seed seed);
+
+    void save(state_writer& out) const;
+    void load(state_reader& in);
 
-    void sketch(const vector<uint32_t>& input, vector<uint32_t>& output);
+    void sketch(const vector<key_type>& input, vector<uint32_t>& output);
+    // Sketch set i of sets into set i of output on the threads of pool.
+    // Sketches of sets with fewer than k distinct hash values are shorter
+    // than k, as those of sketch().
+    void sketch_batch(const csr_sets<key_type>& sets, csr_sets<uint32_t>& output,
+                      thread_pool& pool = thread_pool::global());
 
+    // Also for partial sketches of small sets.
     double estimate(const vector<uint32_t>& A, const vector<uint32_t>& B);
 };
 
 template <class F>
-bottom_k<F>::bottom_k()
+bottom_k<F>::bottom_k() : bottom_k(200) // default value
 {
-    bottom_k(200); // default value
 }
 
 template <class F>
-bottom_k<F>::bottom_k(uint32_t k)
+bottom_k<F>::bottom_k(uint32_t k) : bottom_k(k, random_seed())
+{
+}
+
+template <class F>
+bottom_k<F>::bottom_k(uint32_t k, hash_seed seed)
 {
     m_k = k;
 
-    h.init(); // Initialize the hash function
+    h.init(seed_rng(seed).split()); // Initialize the hash function
 }
 
-// Create the bottom-k sketch. We assume that the input set has at least k
-// elements. Otherwise the sketch is not good.
 template <class F>
-void bottom_k<F>::sketch(const vector<uint32_t>& input, vector<uint32_t>& output)
+void bottom_k<F>::save(state_writer& out) const
 {
-    assert(input.size() >= m_k);
+    out.tag("bottom_k");
+    out.put(m_k);
+    h.save(out);
+}
 
-    priority_queue<uint32_t> pq;
+template <class F>
+void bottom_k<F>::load(state_reader& in)
+{
+    in.tag("bottom_k");
+    in.get(m_k);
+    if (m_k == 0)
+        throw state_error("bad bottom_k size");
+    h.load(in);
+}
 
-    for (auto it = input.begin(); it != input.end(); ++it) {
-        uint32_t v = h(*it);
-        if (pq.size() < m_k)
-            pq.push(v);
-        else if (pq.top() > v) {
-            pq.pop();
-            pq.push(v);
+// Create the bottom-k sketch. Values above thr cannot be among the k
+// smallest. Values equal to it pass, so thr can start at the maximum.
+template <class F>
+size_t bottom_k<F>::sketch_row(const key_type* input, size_t n, uint32_t* output, vector<uint32_t>& buf) const
+{
+    // A block that passes completely fits after 2k - 1 buffered values.
+    buf.resize(2 * (size_t)m_k + SKETCH_BLOCK);
+    uint32_t thr = numeric_limits<uint32_t>::max();
+    size_t m = 0;
+
+    uint32_t hv[SKETCH_BLOCK];
+    for (size_t i = 0; i < n; i += SKETCH_BLOCK) {
+        size_t len = min(SKETCH_BLOCK, n - i);
+        h.hash_many(input + i, hv, len);
+        m += filter_le(hv, len, thr, &buf[m]);
+        if (m >= 2 * (size_t)m_k) {
+            // Sort rather than nth_element, so duplicates cannot take the
+            // place of distinct values among the k smallest.
+            sort(buf.begin(), buf.begin() + m);
+            m = unique(buf.begin(), buf.begin() + m) - buf.begin();
+            if (m >= m_k) {
+                thr = buf[m_k - 1];
+                m = m_k;
+            }
         }
     }
 
     // Create the sketch in sorted order.
+    sort(buf.begin(), buf.begin() + m);
+    m = min((size_t)m_k, (size_t)(unique(buf.begin(), buf.begin() + m) - buf.begin()));
+    copy(buf.begin(), buf.begin() + m, output);
+    return m;
+}
+
+template <class F>
+void bottom_k<F>::sketch(const vector<key_type>& input, vector<uint32_t>& output)
+{
+    vector<uint32_t> buf;
     output.resize(m_k);
-    for (int i = m_k-1; i >= 0; --i) {
-        output[i] = pq.top();
-        pq.pop();
+    output.resize(sketch_row(input.data(), input.size(), &output[0], buf));
+}
+
+// One buffer per thread, reused for all sets of that thread. Set i is
+// sketched into [i*k, (i+1)*k) of the elements, and the sketches are then
+// moved down to their sizes.
+template <class F>
+void bottom_k<F>::sketch_batch(const csr_sets<key_type>& sets, csr_sets<uint32_t>& output, thread_pool& pool)
+{
+    vector<uint32_t>& vals = output.elements;
+    vector<size_t>& offsets = output.offsets;
+    vals.resize(sets.size() * m_k);
+    offsets.assign(sets.size() + 1, 0);
+    vector<vector<uint32_t>> bufs(pool.size());
+    pool.parallel_for(sets.size(), [&](size_t begin, size_t end, unsigned thread) {
+        for (size_t i = begin; i < end; ++i)
+            offsets[i + 1] = sketch_row(sets.set(i), sets.set_size(i), &vals[i * m_k], bufs[thread]);
+    });
+    for (size_t i = 0; i < sets.size(); ++i) {
+        size_t m = offsets[i + 1];
+        offsets[i + 1] = offsets[i] + m;
+        copy(vals.begin() + i * m_k, vals.begin() + i * m_k + m, vals.begin() + offsets[i]);
     }
+    vals.resize(offsets.back());
 }
 
+// The k smallest values of the union of the two sketches are a sample of
+// the union of the sets, and those in both sketches are in the
+// intersection. Sketches of sets with fewer than k elements hold the whole
+// set, so the union can have fewer than k values.
 template <class F>
 double bottom_k<F>::estimate(const vector<uint32_t>& A, const vector<uint32_t>& B)
 {
-    assert(A.size() == B.size());
-    assert(A.size() == m_k);
+    assert(A.size() <= m_k);
+    assert(B.size() <= m_k);
 
+    auto endA = A.end(), endB = B.end();
     // Count intersection among k smallest in total
     uint32_t cInt = 0;
     uint32_t seen = 0;
-    for (auto it1 = A.begin(), it2 = B.begin(); it1 != A.end(), it2 != B.end();) {
-        if (*it1 == *it2) {
-            ++cInt;
+    for (auto it1 = A.begin(), it2 = B.begin(); (it1 != endA || it2 != endB) && seen < m_k; ++seen) {
+        if (it2 == endB || (it1 != endA && *it1 < *it2))
             ++it1;
+        else if (it1 == endA || *it2 < *it1)
             ++it2;
-        }
-        else if (*it1 < *it2)
+        else {
+            ++cInt;
             ++it1;
-        else
             ++it2;
-        if (++seen == m_k)
-            break;
+        }
     }
-    return (double)cInt/(double)m_k;
+    return seen ? (double)cInt/(double)seen : 0.0;
+}
+
+
+
+/* *******************************************************
+ * A bottom-k sketch built in parts: The k smallest
+ * distinct hash values seen so far, sorted. Keys can be
+ * inserted and states merged. A hash value that is
+ * already in the sketch is not added again, as in
+ * bottom_k::sketch(), so keys in several parts count
+ * once. The same seed rule as for k_partition_state
+ * applies.
+ * *******************************************************/
+
+template <class F>
+class bottom_k_state
+{
+    public:
+    typedef typename F::key_type key_type;
+
+    private:
+    const bottom_k<F>* m_sketch;
+    vector<uint32_t> m_vals;
+
+    void add(uint32_t v);
+
+    public:
+    // The state of the empty set.
+    explicit bottom_k_state(const bottom_k<F>& sketch);
+    // A state from a sketch, e.g. of sketch(), sketch_batch() or finalize()
+    // of another state.
+    bottom_k_state(const bottom_k<F>& sketch, const vector<uint32_t>& vals);
+
+    void insert(key_type x);
+    void insert(const vector<key_type>& input);
+    void merge(const bottom_k_state& other);
+    void clear() { m_vals.clear(); }
+
+    // The sketch, equal to sketch() of all inserted keys. Nothing to do,
+    // bottom-k sketches need no densification.
+    const vector<uint32_t>& finalize() const { return m_vals; }
+};
+
+template <class F>
+bottom_k_state<F>::bottom_k_state(const bottom_k<F>& sketch) : m_sketch(&sketch)
+{
+    m_vals.reserve(sketch.m_k);
+}
+
+template <class F>
+bottom_k_state<F>::bottom_k_state(const bottom_k<F>& sketch, const vector<uint32_t>& vals)
+    : m_sketch(&sketch), m_vals(vals)
+{
+    if (m_vals.size() > sketch.m_k ||
+        adjacent_find(m_vals.begin(), m_vals.end(), greater_equal<uint32_t>()) != m_vals.end())
+        throw invalid_argument("bottom_k_state: not a strictly increasing sketch of size at most k");
 }
 
+template <class F>
+void bottom_k_state<F>::add(uint32_t v)
+{
+    if (m_vals.size() == m_sketch->m_k && v >= m_vals.back())
+        return;
+    auto it = lower_bound(m_vals.begin(), m_vals.end(), v);
+    if (it != m_vals.end() && *it == v)
+        return;
+    if (m_vals.size() == m_sketch->m_k)
+        m_vals.pop_back();
+    m_vals.insert(it, v);
+}
 
+template <class F>
+void bottom_k_state<F>::insert(key_type x)
+{
+    add(m_sketch->h(x));
+}
+
+template <class F>
+void bottom_k_state<F>::insert(const vector<key_type>& input)
+{
+    bottom_k_state part(*m_sketch);
+    vector<uint32_t> buf;
+    part.m_vals.resize(m_sketch->m_k);
+    part.m_vals.resize(m_sketch->sketch_row(input.data(), input.size(), &part.m_vals[0], buf));
+    merge(part);
+}
+
+// The k smallest distinct values of both.
+template <class F>
+void bottom_k_state<F>::merge(const bottom_k_state& other)
+{
+    vector<uint32_t> merged;
+    merged.reserve(m_vals.size() + other.m_vals.size());
+    set_union(m_vals.begin(), m_vals.end(), other.m_vals.begin(), other.m_vals.end(),
+              back_inserter(merged));
+    if (merged.size() > m_sketch->m_k)
+        merged.resize(m_sketch->m_k);
+    m_vals.swap(merged);
+}
 
 #endif // _SKETCHES_H_
@@ -0,0 +1,165 @@
+/* ***********************************************
+ * Binary state of hash functions and sketches:
+ * Every hash function and sketch has
+ *     void save(state_writer& out) const;
+ *     void load(state_reader& in);
+ * A loaded object computes exactly the same values
+ * as the saved one, so sketches made in different
+ * processes or on different machines can be
+ * compared.
+ *
+ * The state is the raw words of the tables and
+ * coefficients in native byte order, preceded by a
+ * tag naming the type. Loading into a different
+ * type or from a truncated buffer throws a
+ * state_error.
+ *
+ * save_state/load_state write and read a file.
+ * load_state maps the file instead of reading it,
+ * and state_file can be used directly to load many
+ * objects from one mapping.
+ * ***********************************************/
+
+#ifndef _STATE_H_
+#define _STATE_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <ostream>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+class state_error : public std::runtime_error
+{
+public:
+    explicit state_error(const std::string& what) : std::runtime_error(what) { }
+};
+
+class state_writer
+{
+    std::ostream& m_out;
+
+public:
+    explicit state_writer(std::ostream& out) : m_out(out) { }
+
+    void tag(const std::string& name);
+    void put(const void* p, size_t bytes);
+    template <class T> void put(const T& v) { put(&v, sizeof(T)); }
+};
+
+void state_writer::tag(const std::string& name)
+{
+    put((uint32_t)name.size());
+    put(name.data(), name.size());
+}
+
+void state_writer::put(const void* p, size_t bytes)
+{
+    m_out.write((const char*)p, bytes);
+    if (!m_out)
+        throw state_error("write failed");
+}
+
+class state_reader
+{
+    const char* m_pos;
+    const char* m_end;
+
+public:
+    state_reader(const void* data, size_t len)
+        : m_pos((const char*)data), m_end((const char*)data + len) { }
+
+    // Throws unless the next tag is name.
+    void tag(const std::string& name);
+    void get(void* p, size_t bytes);
+    template <class T> void get(T& v) { get(&v, sizeof(T)); }
+    template <class T> T get() { T v; get(&v, sizeof(T)); return v; }
+    size_t remaining() const { return m_end - m_pos; }
+};
+
+void state_reader::tag(const std::string& name)
+{
+    uint32_t len = get<uint32_t>();
+    if (len > remaining() || std::string(m_pos, len) != name)
+        throw state_error("expected state of " + name);
+    m_pos += len;
+}
+
+void state_reader::get(void* p, size_t bytes)
+{
+    if (bytes > remaining())
+        throw state_error("state truncated");
+    memcpy(p, m_pos, bytes);
+    m_pos += bytes;
+}
+
+// A state file mapped read-only into memory.
+class state_file
+{
+    void* m_data;
+    size_t m_len;
+
+    state_file(const state_file&);
+    state_file& operator=(const state_file&);
+
+public:
+    explicit state_file(const char* path);
+    ~state_file();
+
+    state_reader reader() const { return state_reader(m_data, m_len); }
+};
+
+state_file::state_file(const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        throw state_error(std::string("cannot open ") + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw state_error(std::string("cannot stat ") + path);
+    }
+    m_len = st.st_size;
+    m_data = NULL;
+    if (m_len > 0) {
+        m_data = mmap(NULL, m_len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m_data == MAP_FAILED) {
+            close(fd);
+            throw state_error(std::string("cannot map ") + path);
+        }
+    }
+    close(fd);
+}
+
+state_file::~state_file()
+{
+    if (m_data)
+        munmap(m_data, m_len);
+}
+
+template <class T>
+void save_state(const T& obj, const char* path)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+        throw state_error(std::string("cannot create ") + path);
+    state_writer w(out);
+    obj.save(w);
+}
+
+template <class T>
+void load_state(T& obj, const char* path)
+{
+    state_file f(path);
+    state_reader r = f.reader();
+    obj.load(r);
+}
+
+#endif // _STATE_H_
@@ -0,0 +1,158 @@
+/* ***********************************************
+ * Storage for tabulation tables:
+ * A table with one row of entries per character
+ * position. The layout decides which entries share
+ * cache lines, the allocation decides alignment
+ * and page size.
+ *
+ * TAB_POSITION_MAJOR: all entries of one position
+ *     are contiguous (T[pos][char]).
+ * TAB_INTERLEAVED: the entries of all positions for
+ *     one character are contiguous (T[char][pos]).
+ *     This is the layout of the fixed-size tables in
+ *     hashing.h.
+ *
+ * TAB_ALLOC_DEFAULT: plain new[].
+ * TAB_ALLOC_ALIGNED: 64-byte (cache line) aligned.
+ * TAB_ALLOC_HUGEPAGE: 2MB aligned and advised to be
+ *     backed by transparent huge pages. Tables
+ *     smaller than 1MB are only cache line aligned,
+ *     since they would waste most of the page.
+ * ***********************************************/
+
+#ifndef _TABTABLE_H_
+#define _TABTABLE_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+enum tab_layout
+{
+    TAB_POSITION_MAJOR,
+    TAB_INTERLEAVED
+};
+
+enum tab_alloc
+{
+    TAB_ALLOC_DEFAULT,
+    TAB_ALLOC_ALIGNED,
+    TAB_ALLOC_HUGEPAGE
+};
+
+template <class T, uint32_t Positions, uint32_t Chars, tab_layout Layout, tab_alloc Alloc>
+class tab_table
+{
+    T* m_data;
+    void* m_mem;     // Start of the allocation
+    size_t m_mapped; // Length of the mapping if mmap was used, otherwise 0
+
+    void allocate();
+    void release();
+
+public:
+    static const size_t entries = (size_t)Positions * Chars;
+    static const size_t bytes = entries * sizeof(T);
+
+    tab_table();
+    tab_table(const tab_table& other);
+    tab_table& operator=(const tab_table& other);
+    ~tab_table();
+
+    static size_t index(uint32_t pos, uint32_t c)
+    {
+        return Layout == TAB_POSITION_MAJOR ? (size_t)pos*Chars + c : (size_t)c*Positions + pos;
+    }
+    T& operator()(uint32_t pos, uint32_t c) { return m_data[index(pos, c)]; }
+    const T& operator()(uint32_t pos, uint32_t c) const { return m_data[index(pos, c)]; }
+    T* data() { return m_data; }
+    const T* data() const { return m_data; }
+};
+
+template <class T, uint32_t P, uint32_t C, tab_layout L, tab_alloc A>
+const size_t tab_table<T,P,C,L,A>::entries;
+template <class T, uint32_t P, uint32_t C, tab_layout L, tab_alloc A>
+const size_t tab_table<T,P,C,L,A>::bytes;
+
+template <class T, uint32_t P, uint32_t C, tab_layout L, tab_alloc A>
+tab_table<T,P,C,L,A>::tab_table()
+{
+    allocate();
+}
+
+template <class T, uint32_t P, uint32_t C, tab_layout L, tab_alloc A>
+tab_table<T,P,C,L,A>::tab_table(const tab_table& other)
+{
+    allocate();
+    memcpy(m_data, other.m_data, bytes);
+}
+
+template <class T, uint32_t P, uint32_t C, tab_layout L, tab_alloc A>
+tab_table<T,P,C,L,A>& tab_table<T,P,C,L,A>::operator=(const tab_table& other)
+{
+    if (this != &other)
+        memcpy(m_data, other.m_data, bytes);
+    return *this;
+}
+
+template <class T, uint32_t P, uint32_t C, tab_layout L, tab_alloc A>
+tab_table<T,P,C,L,A>::~tab_table()
+{
+    release();
+}
+
+template <class T, uint32_t P, uint32_t C, tab_layout L, tab_alloc A>
+void tab_table<T,P,C,L,A>::allocate()
+{
+    m_mapped = 0;
+    m_mem = NULL;
+#ifdef __linux__
+    const size_t huge = 2 << 20;
+    if (A == TAB_ALLOC_HUGEPAGE && bytes >= huge/2) {
+        // Over-allocate by one huge page so the table can start on a huge
+        // page boundary.
+        size_t len = (bytes + huge - 1) / huge * huge + huge;
+        void* p = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if (p != MAP_FAILED) {
+            uintptr_t start = ((uintptr_t)p + huge - 1) / huge * huge;
+#ifdef MADV_HUGEPAGE
+            madvise((void*)start, len - (start - (uintptr_t)p), MADV_HUGEPAGE);
+#endif
+            m_mem = p;
+            m_mapped = len;
+            m_data = (T*)start;
+            return;
+        }
+    }
+#endif
+    if (A == TAB_ALLOC_DEFAULT) {
+        m_mem = ::operator new(bytes);
+    }
+    else if (posix_memalign(&m_mem, 64, bytes) != 0) {
+        throw std::bad_alloc();
+    }
+    m_data = (T*)m_mem;
+}
+
+template <class T, uint32_t P, uint32_t C, tab_layout L, tab_alloc A>
+void tab_table<T,P,C,L,A>::release()
+{
+#ifdef __linux__
+    if (m_mapped) {
+        munmap(m_mem, m_mapped);
+        return;
+    }
+#endif
+    if (A == TAB_ALLOC_DEFAULT)
+        ::operator delete(m_mem);
+    else
+        free(m_mem);
+}
+
+#endif // _TABTABLE_H_
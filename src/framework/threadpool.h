@@ -0,0 +1,240 @@
+/* ***********************************************
+ * Work-stealing thread pool:
+ * parallel_for(n, fn) splits [0, n) into chunks and
+ * hands each thread an equal share of them. A thread
+ * takes chunks from the front of its own share and,
+ * once that is empty, steals the back half of the
+ * share of another thread, so sets of very different
+ * sizes still keep all threads busy. Shares are one
+ * atomic word each, and taking or stealing is one
+ * compare-and-swap.
+ *
+ * fn(begin, end, thread) is called for every chunk,
+ * with thread in [0, size()) so callers can keep
+ * scratch space per thread. The calling thread works
+ * as thread 0, and parallel_for returns when all of
+ * [0, n) is done. An exception thrown by fn is passed
+ * on to the caller once the other threads stop.
+ * Calls of parallel_for on one pool run one at a
+ * time, so fn must not use the pool it runs on.
+ * ***********************************************/
+
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <algorithm>
+
+class thread_pool
+{
+    // Chunks [lo, hi) of a thread, lo in the high and hi in the low 32 bits.
+    // Aligned to a cache line so threads do not share them.
+    struct alignas(64) share
+    {
+        std::atomic<uint64_t> range;
+    };
+
+    unsigned m_threads;
+    std::vector<std::thread> m_workers;
+    std::vector<share> m_shares;
+
+    std::mutex m_call; // Held by the running parallel_for
+
+    // The current job, guarded by m_lock.
+    std::mutex m_lock;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    uint64_t m_generation;
+    unsigned m_running;
+    bool m_stop;
+    std::function<void(size_t, size_t, unsigned)> m_fn;
+    size_t m_n;
+    size_t m_grain;
+    std::exception_ptr m_error;
+    std::atomic<bool> m_failed;
+
+    thread_pool(const thread_pool&);
+    thread_pool& operator=(const thread_pool&);
+
+    static unsigned default_threads() { return std::max(1u, std::thread::hardware_concurrency()); }
+    static uint64_t pack(uint32_t lo, uint32_t hi) { return ((uint64_t)lo << 32) | hi; }
+    bool take(unsigned self, uint32_t& chunk);
+    bool steal(unsigned self, uint32_t& chunk);
+    void work(unsigned self);
+    void worker(unsigned self);
+
+public:
+    // threads = 0 uses one thread per hardware thread.
+    explicit thread_pool(unsigned threads = 0);
+    ~thread_pool();
+
+    // A pool with one thread per hardware thread, created on first use.
+    static thread_pool& global();
+
+    unsigned size() const { return m_threads; }
+
+    // Run fn(begin, end, thread) on chunks of grain indices covering [0, n).
+    void parallel_for(size_t n, size_t grain, std::function<void(size_t, size_t, unsigned)> fn);
+    // The same with a grain that gives every thread about 16 chunks.
+    void parallel_for(size_t n, std::function<void(size_t, size_t, unsigned)> fn);
+};
+
+thread_pool::thread_pool(unsigned threads)
+    : m_threads(threads ? threads : default_threads()), m_shares(m_threads),
+      m_generation(0), m_running(0), m_stop(false), m_n(0), m_grain(1), m_failed(false)
+{
+    for (unsigned t = 1; t < m_threads; ++t)
+        m_workers.push_back(std::thread(&thread_pool::worker, this, t));
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_stop = true;
+    }
+    m_start.notify_all();
+    for (size_t i = 0; i < m_workers.size(); ++i)
+        m_workers[i].join();
+}
+
+thread_pool& thread_pool::global()
+{
+    static thread_pool pool;
+    return pool;
+}
+
+// Take the first chunk of the own share.
+bool thread_pool::take(unsigned self, uint32_t& chunk)
+{
+    std::atomic<uint64_t>& r = m_shares[self].range;
+    uint64_t cur = r.load();
+    while (true) {
+        uint32_t lo = (uint32_t)(cur >> 32), hi = (uint32_t)cur;
+        if (lo >= hi)
+            return false;
+        if (r.compare_exchange_weak(cur, pack(lo + 1, hi))) {
+            chunk = lo;
+            return true;
+        }
+    }
+}
+
+// Steal the back half of the share of another thread, keep its first chunk
+// and make the rest the own share.
+bool thread_pool::steal(unsigned self, uint32_t& chunk)
+{
+    for (unsigned i = 1; i < m_threads; ++i) {
+        std::atomic<uint64_t>& r = m_shares[(self + i) % m_threads].range;
+        uint64_t cur = r.load();
+        while (true) {
+            uint32_t lo = (uint32_t)(cur >> 32), hi = (uint32_t)cur;
+            if (lo >= hi)
+                break;
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (r.compare_exchange_weak(cur, pack(lo, mid))) {
+                chunk = mid;
+                m_shares[self].range.store(pack(mid + 1, hi));
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void thread_pool::work(unsigned self)
+{
+    uint32_t chunk;
+    while (!m_failed.load(std::memory_order_relaxed) && (take(self, chunk) || steal(self, chunk))) {
+        size_t begin = (size_t)chunk * m_grain;
+        size_t end = std::min(m_n, begin + m_grain);
+        try {
+            m_fn(begin, end, self);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> guard(m_lock);
+            if (!m_error)
+                m_error = std::current_exception();
+            m_failed = true;
+        }
+    }
+}
+
+void thread_pool::worker(unsigned self)
+{
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(m_lock);
+            while (!m_stop && m_generation == seen)
+                m_start.wait(guard);
+            if (m_stop)
+                return;
+            seen = m_generation;
+        }
+        work(self);
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            if (--m_running == 0)
+                m_done.notify_all();
+        }
+    }
+}
+
+void thread_pool::parallel_for(size_t n, size_t grain, std::function<void(size_t, size_t, unsigned)> fn)
+{
+    if (n == 0)
+        return;
+    // Chunk numbers must fit the 32-bit halves of a share.
+    grain = std::max<size_t>(grain, n / UINT32_MAX + 1);
+    size_t chunks = (n + grain - 1) / grain;
+    std::lock_guard<std::mutex> call(m_call);
+    if (m_threads == 1 || chunks == 1) {
+        fn(0, n, 0);
+        return;
+    }
+
+    // Equal shares of the chunks.
+    for (unsigned t = 0; t < m_threads; ++t) {
+        uint32_t lo = (uint32_t)(chunks * t / m_threads);
+        uint32_t hi = (uint32_t)(chunks * (t + 1) / m_threads);
+        m_shares[t].range.store(pack(lo, hi));
+    }
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_fn = fn;
+        m_n = n;
+        m_grain = grain;
+        m_error = std::exception_ptr();
+        m_failed = false;
+        m_running = m_threads - 1;
+        ++m_generation;
+    }
+    m_start.notify_all();
+    work(0);
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> guard(m_lock);
+        while (m_running > 0)
+            m_done.wait(guard);
+        m_fn = std::function<void(size_t, size_t, unsigned)>();
+        error = m_error;
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void thread_pool::parallel_for(size_t n, std::function<void(size_t, size_t, unsigned)> fn)
+{
+    parallel_for(n, n / (16 * (size_t)m_threads) + 1, fn);
+}
+
+#endif // _THREADPOOL_H_
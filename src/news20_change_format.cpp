@@ -1,4 +1,6 @@
 #include <set>
+#include <vector>
+#include <string>
 #include <sstream>
 #include <algorithm>
 #include <cassert>
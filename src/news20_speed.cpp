@@ -11,6 +11,7 @@
 #include "framework/sketches.h"
 #include "framework/hashing.h"
 #include "framework/hashing_more.h"
+#include "framework/perfcounters.h"
 
 typedef pair<uint32_t, double> pid;
 
@@ -20,6 +21,7 @@ const string strFile = "data/news20-fast.txt";
 
 void readData(vector<vector<pid>>& data)
 {
+    perf_scope scope("io");
     data.resize(0);
     
     ifstream in(strFile.c_str());
@@ -43,12 +45,38 @@ void readData(vector<vector<pid>>& data)
     in.close();
 }
 
+// Keeps the hash values of testHashing from being optimized away.
+volatile uint32_t hash_sink;
+
+// Only the hashing of the indices, with hash_many, as a phase for the
+// performance counters, to compare with the sketching.
+template <class T>
+void testHashing(const vector<vector<pid>>& data, string name)
+{
+    T h;
+    h.init();
+    vector<uint32_t> idx;
+    for (auto it = data.begin(); it != data.end(); ++it)
+        for (auto jt = it->begin(); jt != it->end(); ++jt)
+            idx.push_back(jt->first);
+    vector<uint32_t> hv(idx.size() + 1);
+
+    perf_scope scope("hashing (" + name + ")", idx.size());
+    h.hash_many(idx.data(), &hv[0], idx.size());
+    hash_sink = hv[0];
+}
+
 template <class T>
 void testInner(const vector<vector<pid>>& data, string name)
 {
     vector<double> sk;
     clock_t start, end;
     f_hash<T> fh(128);
+    uint64_t keys = 0;
+    for (auto it = data.begin(); it != data.end(); ++it)
+        keys += it->size();
+    testHashing<T>(data, name);
+    perf_scope scope("sketching (" + name + ")", keys);
     
     start = clock();
     for (auto it = data.begin(); it != data.end(); ++it) {
@@ -58,28 +86,42 @@ void testInner(const vector<vector<pid>>& data, string name)
     cout << name << " & " << (float)(end-start)/(CLOCKS_PER_SEC/1000) << "ms \\\\" << endl;
 }
 
+// The same with sketch_batch on all threads. clock() adds up the time of
+// all threads, so this measures wall time.
+template <class T>
+void testBatch(const csr_sets<pid>& sets, string name)
+{
+    vector<double> sk;
+    f_hash<T> fh(128);
+    perf_scope scope("batch sketching (" + name + ")", sets.elements.size());
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    fh.sketch_batch(sets, sk);
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    cout << name << " (" << thread_pool::global().size() << " threads) & "
+         << chrono::duration<float, milli>(end-start).count() << "ms \\\\" << endl;
+}
+
 void testSketches(const vector<vector<pid>>& data)
 {
     testInner<multishift>(data, "Multiply-shift");
     testInner<mixedtab>(data, "Mixed Tabulation");
+    testInner<mixedtab128>(data, "Mixed Tabulation (128-bit entries)");
     testInner<polyhash2>(data, "2-wise PolyHash");
     testInner<polyhash3>(data, "3-wise PolyHash");
-
-    vector<double> sk;
-    clock_t start, end;
-    f_hash<polyhash> fh(128,20);
-    
-    start = clock();
-    for (auto it = data.begin(); it != data.end(); ++it) {
-        fh.sketch(*it, sk);
-    }
-    end = clock();
-    cout << "20-wise PolyHash" << " & " << (float)(end-start)/(CLOCKS_PER_SEC/1000) << "ms \\\\" << endl;
-
+    testInner<polyhash_k<20>>(data, "20-wise PolyHash");
 
     testInner<murmurwrap>(data, "MurmurHash3");
     testInner<citywrap>(data, "CityHash");
     testInner<blake2wrap>(data, "Blake2");
+
+    csr_sets<pid> sets;
+    for (auto it = data.begin(); it != data.end(); ++it)
+        sets.push_back(*it);
+    cout << endl << "Batch sketching: " << endl << endl;
+    testBatch<multishift>(sets, "Multiply-shift");
+    testBatch<mixedtab>(sets, "Mixed Tabulation");
+    testBatch<murmurwrap>(sets, "MurmurHash3");
 }
 
 int main()
@@ -89,4 +131,5 @@ int main()
     readData(data);
     cout << "Performing speed test: " << endl << endl;
     testSketches(data);
+    perf_phases::global().report(cout);
 }
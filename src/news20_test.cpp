@@ -21,7 +21,7 @@ void testSketches(vector<double>& skMS, vector<double>& skMT, vector<double>& sk
     f_hash<multishift> fh_ms(256);
     f_hash<polyhash> fh_poly(256);
     f_hash<murmurwrap> fh_mur(256);
-    f_hash<polyhash> fh_p20(256,20);
+    f_hash<polyhash_k<20>> fh_p20(256);
 
     skMS.resize(0);
     skMT.resize(0);
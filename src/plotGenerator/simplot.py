@@ -6,6 +6,7 @@ samples3 = np.fromfile("../output/sim_mt.txt",sep="\n")
 samples2 = np.fromfile("../output/sim_poly.txt",sep="\n")
 samples4 = np.fromfile("../output/sim_mur.txt",sep="\n")
 samples5 = np.fromfile("../output/sim_poly20.txt",sep="\n")
+samples6 = np.fromfile("../output/sim_tornado.txt",sep="\n")
 
 def mse(l,m):
     return np.round(np.mean(map(lambda x : (x-m)**2, l)),4)
@@ -51,3 +52,4 @@ printStats(samples1, "multiply-shift")
 printStats(samples2, "Mixed tab")
 printStats(samples3, "2-wise PolyHash")
 printStats(samples4, "20-wise PolyHash")
+printStats(samples6, "Tornado tab")
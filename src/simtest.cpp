@@ -2,80 +2,94 @@
 #include <iostream>
 
 #include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
 
 #include "framework/hashing.h"
 #include "framework/hashing_more.h"
 #include "framework/sketches.h"
+#include "framework/perfcounters.h"
 #include "datasets.h"
 
+// Keeps the hash values of the hashing phase from being optimized away.
+volatile uint32_t hash_sink;
+
+/* The trials of one hash function, as three phases for the performance
+ * counters: hashing the keys of A and B with hash_many only, sketching A
+ * and B, and estimating the similarity from the sketches. Each trial makes
+ * a new hash function or sketch. The sketches draw their seeds from seeds
+ * in the order of the trials; the hashing phase uses seeds of its own, so
+ * it does not change the sketches of a run.
+ * */
+template <class F>
+void runTrials(const string& name, const vector<uint32_t>& A, const vector<uint32_t>& B,
+        uint32_t trials, uint32_t k, seed_rng& seeds, vector<double>& results)
+{
+    // Keys hashed per phase, for the performance counters
+    uint64_t keys = (uint64_t)trials * (A.size() + B.size());
+
+    {
+        perf_scope scope("hashing (" + name + ")", keys);
+        vector<uint32_t> hv(max(A.size(), B.size()) + 1);
+        uint32_t sum = 0;
+        for (uint32_t i = 0; i < trials; ++i) {
+            F h;
+            h.init(hash_seed(i));
+            h.hash_many(A.data(), &hv[0], A.size());
+            sum += hv[0];
+            h.hash_many(B.data(), &hv[0], B.size());
+            sum += hv[0];
+        }
+        hash_sink = sum;
+    }
+
+    vector<vector<uint32_t>> Ak(trials), Bk(trials);
+    {
+        perf_scope scope("sketching (" + name + ")", keys);
+        for (uint32_t i = 0; i < trials; ++i) {
+            k_partition<F> sketch(k, seeds.split());
+            sketch.sketch(A, Ak[i]);
+            sketch.sketch(B, Bk[i]);
+        }
+    }
+
+    // estimate() only compares the sketches, so any sketch with the same k
+    // does. Counted per estimate.
+    {
+        k_partition<F> sketch(k, hash_seed(0));
+        perf_scope scope("estimation (" + name + ")", trials);
+        for (uint32_t i = 0; i < trials; ++i)
+            results.push_back(sketch.estimate(Ak[i], Bk[i]));
+    }
+}
+
 /* Test code for similarity estimation with different hash functions
+ * All sketches are built from seeds drawn from the given seed, so the hash
+ * functions of a run can be reproduced.
  * */
 void testSimilarity(uint32_t sdSize, uint32_t intSize,
-        uint32_t trials, uint32_t k)
+        uint32_t trials, uint32_t k, hash_seed seed)
 {
+    seed_rng seeds(seed);
+
     // Create sets for estimation
     vector<uint32_t> A,B;
     intSize = genBinarySets(A,B,sdSize,intSize,0.5);
 
     // Experiment results
     double ground_truth = (double)intSize/(double)(intSize + sdSize);
-    vector<double> results_ms, results_mt, results_poly, results_poly20, results_mur;
-
-    // Run the trials with multiply-shift
-    for (uint32_t i = 0; i < trials; ++i) {
-        k_partition<multishift> sketch(k);
-
-        vector<uint32_t> Ak, Bk;
-        sketch.sketch(A, Ak);
-        sketch.sketch(B, Bk);
-        results_ms.push_back(sketch.estimate(Ak,Bk));
-    }
-    
-    // Run the trials with mixed tabulation
-    for (uint32_t i = 0; i < trials; ++i) {
-        k_partition<mixedtab> sketch(k);
-
-        // Create sketches
-        vector<uint32_t> Ak, Bk;
-        sketch.sketch(A,Ak);
-        sketch.sketch(B,Bk);
-        results_mt.push_back(sketch.estimate(Ak,Bk));
-    }
-
-    // Run the trials with 20-wise polynomial hashing
-    for (uint32_t i = 0; i < trials; ++i) {
-        k_partition<polyhash> sketch(k,20);
-
-        // Create sketches
-        vector<uint32_t> Ak, Bk;
-        sketch.sketch(A,Ak);
-        sketch.sketch(B,Bk);
-        results_poly20.push_back(sketch.estimate(Ak,Bk));
-    }
-
-    // Run the trials with 2-wise polynomial hashing
-    for (uint32_t i = 0; i < trials; ++i) {
-        k_partition<polyhash2> sketch(k);
-
-        // Create sketches
-        vector<uint32_t> Ak, Bk;
-        sketch.sketch(A,Ak);
-        sketch.sketch(B,Bk);
-        results_poly.push_back(sketch.estimate(Ak,Bk));
-    }
-
-    // Run the trials with 2-wise polynomial hashing
-    for (uint32_t i = 0; i < trials; ++i) {
-        k_partition<murmurwrap> sketch(k);
-
-        // Create sketches
-        vector<uint32_t> Ak, Bk;
-        sketch.sketch(A,Ak);
-        sketch.sketch(B,Bk);
-        results_mur.push_back(sketch.estimate(Ak,Bk));
-    }
+    vector<double> results_ms, results_mt, results_poly, results_poly20, results_mur, results_tor, results_crc;
 
+    runTrials<multishift>("Multiply-Shift", A, B, trials, k, seeds, results_ms);
+    runTrials<mixedtab>("Mixed tab", A, B, trials, k, seeds, results_mt);
+    runTrials<polyhash_k<20>>("polyhash 20", A, B, trials, k, seeds, results_poly20);
+    runTrials<polyhash2>("polyhash 2", A, B, trials, k, seeds, results_poly);
+    runTrials<murmurwrap>("MurmurHash", A, B, trials, k, seeds, results_mur);
+    runTrials<tornadotab>("Tornado tab", A, B, trials, k, seeds, results_tor);
+    runTrials<crc32hash>("CRC32C", A, B, trials, k, seeds, results_crc);
 
+    perf_scope scope("io");
     cout << "Ran trials on sets with actual similarity: " << ground_truth << endl;
     // Output the results sorted for convenience
     sort(results_ms.begin(), results_ms.end());
@@ -128,9 +142,34 @@ void testSimilarity(uint32_t sdSize, uint32_t intSize,
     }
     fout.close();
     cout << "Average error for MurmurHash: " << err/(double)trials << endl;
+
+    sort(results_tor.begin(), results_tor.end());
+    fout.open("output/sim_tornado.txt");
+    err = 0.0;
+    for (auto it = results_tor.begin(); it != results_tor.end(); ++it) {
+        fout << *it << endl;
+        err += abs(*it - ground_truth);
+    }
+    fout.close();
+    cout << "Average error for Tornado tab: " << err/(double)trials << endl;
+
+    sort(results_crc.begin(), results_crc.end());
+    fout.open("output/sim_crc.txt");
+    err = 0.0;
+    for (auto it = results_crc.begin(); it != results_crc.end(); ++it) {
+        fout << *it << endl;
+        err += abs(*it - ground_truth);
+    }
+    fout.close();
+    cout << "Average error for CRC32C: " << err/(double)trials << endl;
 }
 
-int main()
+int main(int argc, char** argv)
 {
-    testSimilarity(100,100,2000,200);
+    // Pass a seed as the first argument to reproduce the hash functions of a
+    // previous run.
+    hash_seed seed = argc > 1 ? hash_seed(strtoull(argv[1], NULL, 10)) : random_seed();
+    cout << "Seed: " << seed.value << endl;
+    testSimilarity(100,100,2000,200,seed);
+    perf_phases::global().report(cout);
 }
@@ -0,0 +1,198 @@
+#include "framework/hashing.h"
+#include "framework/sketches.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+#include <random>
+
+using namespace std;
+
+/* ***************************************************
+ * Consistency of the sketches built in parts: For
+ * k_partition (all densification modes, with hash
+ * functions of one and of several outputs) and
+ * bottom_k the sketch of a set must equal
+ *   - finalize() of a state the keys were inserted
+ *     into one by one,
+ *   - finalize() of the merged states of two
+ *     overlapping parts of the set,
+ *   - its row of sketch_batch,
+ * also when keys repeat and when distinct keys have
+ * equal hash values. Repeated keys and equal hash
+ * values must count once, so the sketch also equals
+ * the sketch of one key per hash value.
+ *
+ * Usage: testsketch [seed]
+ * Prints every mismatch and returns 1 if there is
+ * one.
+ * ***************************************************/
+
+const uint32_t K = 64;
+
+uint32_t errors = 0;
+
+void check(bool ok, const string& what, size_t n)
+{
+    if (!ok) {
+        cerr << "ERROR: " << what << " differs for " << n << " keys" << endl;
+        ++errors;
+    }
+}
+
+// Mixed tabulation of x / 4, so the keys 4y, ..., 4y+3 have equal hash
+// values.
+class collide4
+{
+    mixedtab h;
+
+public:
+    typedef uint32_t key_type;
+    void init(hash_seed seed) { h.init(seed); }
+    uint32_t operator()(uint32_t x) const { return h(x / 4); }
+    void hash_many(const uint32_t* in, uint32_t* out, size_t n) const
+    {
+        for (size_t i = 0; i < n; ++i)
+            out[i] = (*this)(in[i]);
+    }
+};
+
+// Mixed tabulation, except that key 0 has the largest hash value 0xFFFFFFFF,
+// which must count as a real value.
+class withmax
+{
+    mixedtab h;
+
+public:
+    typedef uint32_t key_type;
+    void init(hash_seed seed) { h.init(seed); }
+    uint32_t operator()(uint32_t x) const { return x == 0 ? numeric_limits<uint32_t>::max() : h(x); }
+    void hash_many(const uint32_t* in, uint32_t* out, size_t n) const
+    {
+        for (size_t i = 0; i < n; ++i)
+            out[i] = (*this)(in[i]);
+    }
+};
+
+// Row i of sketch_batch: k values for k_partition, the sketch for bottom_k.
+template <class Sketch>
+vector<uint32_t> batchRow(Sketch& sketch, const csr_sets<uint32_t>& sets, size_t i)
+{
+    vector<uint32_t> rows;
+    sketch.sketch_batch(sets, rows);
+    return vector<uint32_t>(rows.begin() + i*K, rows.begin() + (i+1)*K);
+}
+
+template <class F>
+vector<uint32_t> batchRow(bottom_k<F>& sketch, const csr_sets<uint32_t>& sets, size_t i)
+{
+    csr_sets<uint32_t> rows;
+    sketch.sketch_batch(sets, rows);
+    return vector<uint32_t>(rows.set(i), rows.set(i) + rows.set_size(i));
+}
+
+// Keys 0, ..., n-1 with about a third of them repeated, shuffled, and the
+// same set with one key per group of 4, the keys collide4 maps together.
+void makeKeys(size_t n, mt19937_64& rng, vector<uint32_t>& keys, vector<uint32_t>& single)
+{
+    keys.clear();
+    single.clear();
+    for (size_t i = 0; i < n; ++i) {
+        keys.push_back((uint32_t)i);
+        if (rng() % 3 == 0)
+            keys.push_back((uint32_t)i);
+        if (i % 4 == 0)
+            single.push_back((uint32_t)i);
+    }
+    shuffle(keys.begin(), keys.end(), rng);
+}
+
+// Sketches of a set against the states and the batch row. ref is a set
+// with the same distinct hash values under F.
+template <class Sketch, class State>
+void checkParts(Sketch& sketch, const vector<uint32_t>& keys, const vector<uint32_t>& ref,
+                const string& name, size_t n)
+{
+    vector<uint32_t> full, other;
+    sketch.sketch(keys, full);
+    sketch.sketch(ref, other);
+    check(full == other, name + " sketch of repeated keys", n);
+
+    State one(sketch);
+    for (size_t i = 0; i < keys.size(); ++i)
+        one.insert(keys[i]);
+    check(one.finalize() == full, name + " state of single inserts", n);
+
+    // Two parts that share the middle third.
+    State a(sketch), b(sketch);
+    a.insert(vector<uint32_t>(keys.begin(), keys.begin() + 2*keys.size()/3));
+    b.insert(vector<uint32_t>(keys.begin() + keys.size()/3, keys.end()));
+    a.merge(b);
+    check(a.finalize() == full, name + " merged state", n);
+
+    // Sets of other sizes around it, so the rows of bottom_k have
+    // different lengths.
+    csr_sets<uint32_t> sets;
+    sets.push_back(vector<uint32_t>(1, 7));
+    sets.push_back(keys);
+    sets.push_back(vector<uint32_t>());
+    sets.push_back(ref);
+    check(batchRow(sketch, sets, 1) == full, name + " sketch_batch row", n);
+    check(batchRow(sketch, sets, 3) == other, name + " sketch_batch row of other set", n);
+}
+
+template <class F>
+void checkHash(const string& hname, hash_seed seed, bool collide)
+{
+    seed_rng seeds(seed);
+    mt19937_64 rng(seed.value);
+    const size_t sizes[] = { 0, 1, 10, K - 1, K, 5*K, 50000 };
+    for (size_t n : sizes) {
+        vector<uint32_t> keys, single;
+        makeKeys(n, rng, keys, single);
+        vector<uint32_t> distinct(n);
+        for (size_t i = 0; i < n; ++i)
+            distinct[i] = (uint32_t)i;
+        const vector<uint32_t>& ref = collide ? single : distinct;
+
+        k_partition<F, bin_div, densify_leftright> kl(K, seeds.split());
+        checkParts<k_partition<F, bin_div, densify_leftright>,
+                   k_partition_state<F, bin_div, densify_leftright>>(kl, keys, ref, hname + " k_partition leftright", n);
+        k_partition<F, bin_div, densify_optimal> ko(K, seeds.split());
+        checkParts<k_partition<F, bin_div, densify_optimal>,
+                   k_partition_state<F, bin_div, densify_optimal>>(ko, keys, ref, hname + " k_partition optimal", n);
+        k_partition<F, bin_div, densify_fast> kf(K, seeds.split());
+        checkParts<k_partition<F, bin_div, densify_fast>,
+                   k_partition_state<F, bin_div, densify_fast>>(kf, keys, ref, hname + " k_partition fast", n);
+        bottom_k<F> bk(K, seeds.split());
+        checkParts<bottom_k<F>, bottom_k_state<F>>(bk, keys, ref, hname + " bottom_k", n);
+
+        // Distinct hash values count once, also for sets larger than k.
+        vector<uint32_t> sk;
+        bk.sketch(keys, sk);
+        check(sk.size() == min((size_t)K, ref.size()), hname + " bottom_k size", n);
+        bottom_k_state<F> back(bk, sk);
+        check(back.finalize() == sk, hname + " bottom_k state from sketch", n);
+        check(n == 0 || bk.estimate(sk, sk) == 1.0, hname + " bottom_k estimate of equal sketches", n);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    hash_seed seed = argc > 1 ? hash_seed(strtoull(argv[1], NULL, 10)) : random_seed();
+    cout << "Seed: " << seed.value << ", k = " << K << endl;
+
+    checkHash<mixedtab>("mixedtab", seed, false);
+    checkHash<mixedtab128>("mixedtab128", seed, false);
+    checkHash<collide4>("collide4", seed, true);
+    checkHash<withmax>("withmax", seed, false);
+
+    if (errors) {
+        cout << errors << " checks failed" << endl;
+        return 1;
+    }
+    cout << "All checks passed" << endl;
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include "framework/hashing.h"
+#include "framework/benchmark.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+
+#include <random>
+
+using namespace std;
+
+const uint32_t REPS = 5;
+
+/* Table size vs. speed trade-off for mixed tabulation.
+ * For each parameter choice we report the total table size, the number of
+ * lookups per key and the median time per key with the scalar and the
+ * batched interface.
+ * */
+template <uint32_t K, uint32_t C, uint32_t D>
+void testConfig(uint32_t trials)
+{
+    typedef mixedtab_t<K, C, D> F;
+    typedef typename F::key_type key_type;
+
+    mt19937_64 rng;
+    rng.seed(random_device()());
+    vector<key_type> nums(trials);
+    for (uint32_t i = 0; i < trials; ++i)
+        nums[i] = (key_type)rng();
+    vector<uint32_t> out(trials);
+
+    F h;
+    h.init();
+
+    bench_result scalar, batch;
+    bench_measure(scalar, REPS, trials, false, [&]() {
+        uint32_t acc = 0;
+        for (uint32_t i = 0; i < trials; ++i)
+            acc ^= h(nums[i]);
+        return acc;
+    });
+    bench_measure(batch, REPS, trials, false, [&]() {
+        h.hash_many(&nums[0], &out[0], trials);
+        return out[trials-1];
+    });
+
+    cout << K << " & " << C << " & " << D << " & "
+         << F::table_bytes/1024 << "KB & " << F::chars + F::derived << " & "
+         << scalar.ns.median << "ns & " << batch.ns.median << "ns \\\\" << endl;
+}
+
+/* Table locality: hash with one hasher whose tables stay in cache (warm),
+ * with the caches flushed before every small batch (cold), and with many
+ * hashers used round-robin so their tables compete for the cache (multi).
+ * */
+template <class F>
+void testLocality(string name, uint32_t trials)
+{
+    typedef typename F::key_type key_type;
+    const uint32_t hashers = 32;   // Live hashers in the multi test
+    const uint32_t coldBatch = 256; // Keys hashed between two cache flushes
+    const uint32_t coldRounds = 50;
+    const uint32_t multiBatch = 16; // Keys per hasher before switching
+
+    mt19937_64 rng;
+    rng.seed(random_device()());
+    vector<key_type> nums(trials);
+    for (uint32_t i = 0; i < trials; ++i)
+        nums[i] = (key_type)rng();
+    vector<uint32_t> out(trials);
+
+    vector<F> hs(hashers);
+    for (uint32_t i = 0; i < hashers; ++i)
+        hs[i].init();
+
+    // Warm: a single hasher, tables loaded by a first pass.
+    bench_result warm, cold, multi;
+    bench_measure(warm, REPS, trials, false, [&]() {
+        hs[0].hash_many(&nums[0], &out[0], trials);
+        return out[trials-1];
+    });
+
+    // Cold: the caches are evicted before each small batch, and each
+    // batch hashes new keys.
+    uint32_t round = 0;
+    bench_measure(cold, coldRounds, coldBatch, true, [&]() {
+        hs[0].hash_many(&nums[(round++ % coldRounds)*coldBatch], &out[0], coldBatch);
+        return out[coldBatch-1];
+    });
+
+    // Multi: switch hasher every multiBatch keys.
+    bench_measure(multi, REPS, trials, false, [&]() {
+        for (uint32_t i = 0, j = 0; i + multiBatch <= trials; i += multiBatch, j = (j+1) % hashers)
+            hs[j].hash_many(&nums[i], &out[i], multiBatch);
+        return out[0];
+    });
+
+    cout << name << " & " << warm.ns.median << "ns & " << cold.ns.median << "ns & "
+         << multi.ns.median << "ns \\\\" << endl;
+}
+
+int main()
+{
+    uint32_t trials = 10000000; // 10^7 keys per configuration
+
+    cout << "Key bits & Char bits & Derived & Tables & Lookups & Scalar/key & Batch/key \\\\" << endl;
+    testConfig<32, 8, 1>(trials);
+    testConfig<32, 8, 2>(trials);
+    testConfig<32, 8, 3>(trials);
+    testConfig<32, 8, 4>(trials);
+    testConfig<32, 11, 1>(trials);
+    testConfig<32, 11, 2>(trials);
+    testConfig<32, 11, 3>(trials);
+    testConfig<32, 11, 4>(trials);
+    testConfig<32, 16, 1>(trials);
+    testConfig<32, 16, 2>(trials);
+    testConfig<32, 16, 3>(trials);
+    testConfig<32, 16, 4>(trials);
+    testConfig<64, 8, 1>(trials);
+    testConfig<64, 8, 2>(trials);
+    testConfig<64, 8, 3>(trials);
+    testConfig<64, 8, 4>(trials);
+    testConfig<64, 11, 1>(trials);
+    testConfig<64, 11, 2>(trials);
+    testConfig<64, 11, 3>(trials);
+    testConfig<64, 11, 4>(trials);
+    testConfig<64, 16, 1>(trials);
+    testConfig<64, 16, 2>(trials);
+    testConfig<64, 16, 3>(trials);
+    testConfig<64, 16, 4>(trials);
+
+    cout << endl << "Layout & Warm/key & Cold/key & 32 hashers/key \\\\" << endl;
+    testLocality<mixedtab_t<32, 8, 4, TAB_INTERLEAVED, TAB_ALLOC_DEFAULT>>("8-bit interleaved", trials);
+    testLocality<mixedtab_t<32, 8, 4, TAB_INTERLEAVED, TAB_ALLOC_ALIGNED>>("8-bit interleaved aligned", trials);
+    testLocality<mixedtab_t<32, 8, 4, TAB_POSITION_MAJOR, TAB_ALLOC_DEFAULT>>("8-bit position-major", trials);
+    testLocality<mixedtab_t<32, 8, 4, TAB_POSITION_MAJOR, TAB_ALLOC_ALIGNED>>("8-bit position-major aligned", trials);
+    testLocality<mixedtab_t<32, 16, 2, TAB_INTERLEAVED, TAB_ALLOC_ALIGNED>>("16-bit interleaved aligned", trials);
+    testLocality<mixedtab_t<32, 16, 2, TAB_POSITION_MAJOR, TAB_ALLOC_ALIGNED>>("16-bit position-major aligned", trials);
+    testLocality<mixedtab_t<32, 16, 2, TAB_POSITION_MAJOR, TAB_ALLOC_HUGEPAGE>>("16-bit position-major huge pages", trials);
+}
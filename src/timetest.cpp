@@ -1,109 +1,336 @@
 #include "framework/hashing.h"
 #include "framework/hashing_more.h"
+#include "framework/benchmark.h"
 
 #include <iostream>
-#include <ctime>
+#include <fstream>
 #include <vector>
-#include <chrono>
+#include <functional>
+#include <type_traits>
 
 #include <random>
+#include <string>
+#include <cstdlib>
 
 using namespace std;
 
+/* ***************************************************
+ * Benchmark of the hash functions. For every hash
+ * function and key distribution it times:
+ *   throughput: h(x) of independent keys
+ *   latency:    h(x) where each key depends on the
+ *               previous hash value
+ *   batch:      hash_many in blocks
+ *   batch-wide: hash_many_wide (multi-output only)
+ * with warm tables, and throughput and batch also
+ * right after evicting the caches (cold), on a short
+ * run since only the first keys see the misses.
+ *
+ * It also checks that hash_many gives the same values
+ * as h(x) for every key distribution, and returns 1
+ * if it does not.
+ *
+ * Usage: testtime [--keys N] [--reps R] [--cold-keys N]
+ *                 [--seed S] [--filter NAME] [--json FILE]
+ * ***************************************************/
 
-void testTime(uint32_t trials)
+struct bench_config
 {
-    volatile uint32_t x;
-
-    mt19937 rng;
-    rng.seed(random_device()());
-    uniform_int_distribution<uint32_t> dist;
-    vector<uint32_t> nums;
-    for (uint32_t i = 0; i < trials; ++i)
-        nums.push_back(dist(rng));
-
-    multishift hms;
-    hms.init();
-    clock_t start = clock();
-    for (uint32_t i = 0; i < trials; i+=1)
-        x=hms(nums[i]);
-    clock_t end = clock();
-    cout << "Multiply-shift & " << (float)(end-start)/CLOCKS_PER_SEC << "s \\\\" << endl;
-
-    mixedtab hmt;
-    hmt.init();
-    start = clock();
-    for (uint32_t i = 0; i < trials; ++i)
-        x=hmt(nums[i]);
-    end = clock();
-    cout << "Mixed tabulation & " << (float)(end-start)/CLOCKS_PER_SEC << "s \\\\" << endl;
-
-    polyhash2 hp2;
-    hp2.init();
-    start = clock();
-    for (uint32_t i = 0; i < trials; ++i)
-        x=hp2(nums[i]);
-    end = clock();
-    cout << "2-wise PolyHash & " << (float)(end-start)/CLOCKS_PER_SEC << "s \\\\" << endl;
-
-    polyhash3 hp3;
-    hp3.init();
-    start = clock();
-    for (uint32_t i = 0; i < trials; ++i)
-        x=hp3(nums[i]);
-    end = clock();
-    cout << "3-wise PolyHash & " << (float)(end-start)/CLOCKS_PER_SEC << "s \\\\" << endl;
-
-    polyhash hp20;
-    hp20.init(4);
-    start = clock();
-    for (uint32_t i = 0; i < trials; ++i)
-        x=hp20(nums[i]);
-    end = clock();
-    cout << "20-wise PolyHash & " << (float)(end-start)/CLOCKS_PER_SEC << "s \\\\" << endl;
-
-    murmurwrap mm;
-    mm.init();
-    start = clock();
-    for (uint32_t i = 0; i < trials; ++i)
-        x = mm(nums[i]);
-    end = clock();
-    cout << "MurmurHash3 & " << (float)(end-start)/CLOCKS_PER_SEC << "s \\\\" << endl;
-
-    citywrap cw;
-    cw.init();
-    start = clock();
-    for (uint32_t i = 0; i < trials; ++i)
-        x = cw(nums[i]);
-    end = clock();
-    cout << "CityHash & " << (float)(end-start)/CLOCKS_PER_SEC << "s \\\\" << endl;
-
-    blake2wrap b2;
-    b2.init();
-    start = clock();
-    for (uint32_t i = 0; i < trials; ++i)
-        x = b2(nums[i]);
-    end = clock();
-    cout << "Blake2 & " << (float)(end-start)/CLOCKS_PER_SEC << "s \\\\" << endl;
-
-    simpletab st;
-    st.init();
-    start = clock();
-    for (uint32_t i = 0; i < trials; ++i)
-        x = st(nums[i]);
-    end = clock();
-    cout << "Simple Tabulation & " << (float)(end-start)/CLOCKS_PER_SEC << "s \\\\" << endl;
-
-    twisttab tt;
-    tt.init();
-    start = clock();
-    for (uint32_t i = 0; i < trials; ++i)
-        x = tt(nums[i]);
-    end = clock();
-    cout << "Twisted Tabulation & " << (float)(end-start)/CLOCKS_PER_SEC << "s \\\\" << endl;
+    size_t keys;
+    uint32_t reps;
+    size_t cold_keys;
+    uint64_t seed;
+    string filter;
+    string json;
+};
+
+bench_report report;
+
+// Keys for which hash_many differs from h(x), over all hash functions.
+size_t batch_errors = 0;
+
+// Block size of the batch runs, the output stays in the L1 cache.
+const size_t BATCH_BLOCK = 1024;
+
+// Key distributions:
+//   sequential: x0, x0+1, x0+2, ... from a random x0
+//   random:     uniformly random keys
+//   dense:      uniformly random keys from [0, 2^16), e.g. feature ids
+template <class K>
+vector<K> makeKeys(const string& dist, size_t n, uint64_t seed)
+{
+    mt19937_64 rng(seed);
+    vector<K> keys(n);
+    K x0 = (K)rng();
+    for (size_t i = 0; i < n; ++i) {
+        if (dist == "sequential")
+            keys[i] = x0 + (K)i;
+        else if (dist == "dense")
+            keys[i] = (K)(rng() & 0xffff);
+        else
+            keys[i] = (K)rng();
+    }
+    return keys;
 }
 
-int main()
+template <class F>
+uint32_t runThroughput(const F& h, const vector<typename F::key_type>& keys, size_t n)
 {
-    testTime(10000000); // 10^7 trials
+    uint32_t acc = 0;
+    for (size_t i = 0; i < n; ++i)
+        acc ^= h(keys[i]);
+    return acc;
+}
+
+// Each key is XORed with the previous hash value masked by a zero the
+// compiler cannot see, so the calls cannot overlap but the keys are unchanged.
+template <class F>
+uint32_t runLatency(const F& h, const vector<typename F::key_type>& keys, size_t n)
+{
+    typedef typename F::key_type key_type;
+    const uint32_t mask = bench_zero;
+    uint32_t x = 0;
+    for (size_t i = 0; i < n; ++i)
+        x = h(keys[i] ^ (key_type)(x & mask));
+    return x;
+}
+
+template <class F>
+uint32_t runBatch(const F& h, const vector<typename F::key_type>& keys, size_t n)
+{
+    uint32_t out[BATCH_BLOCK];
+    uint32_t acc = 0;
+    for (size_t i = 0; i < n; i += BATCH_BLOCK) {
+        size_t len = min(BATCH_BLOCK, n - i);
+        h.hash_many(&keys[i], out, len);
+        acc ^= out[len-1];
+    }
+    return acc;
+}
+
+template <class F>
+uint32_t runBatchWide(const F& h, const vector<typename F::key_type>& keys, size_t n)
+{
+    const uint32_t o = hash_outputs<F>::value;
+    uint32_t out[BATCH_BLOCK * o];
+    uint32_t acc = 0;
+    for (size_t i = 0; i < n; i += BATCH_BLOCK) {
+        size_t len = min(BATCH_BLOCK, n - i);
+        h.hash_many_wide(&keys[i], out, len);
+        acc ^= out[len*o - 1];
+    }
+    return acc;
+}
+
+void record(const string& name, const string& dist, const string& mode, bench_result& r)
+{
+    r.hasher = name;
+    r.keys = dist;
+    r.mode = mode;
+    bench_report::print_row(cout, r);
+    report.add(r);
+}
+
+// The batch output must equal the scalar output, for all keys and for every
+// length up to 33, so the scalar tails after the vectors of up to 16 keys
+// are covered. Returns the number of keys that differ.
+template <class F>
+size_t checkBatch(const F& h, const vector<typename F::key_type>& keys, const string& name,
+                  const string& dist)
+{
+    vector<size_t> lens;
+    for (size_t len = 1; len <= min((size_t)33, keys.size()); ++len)
+        lens.push_back(len);
+    if (keys.size() > 33)
+        lens.push_back(keys.size());
+
+    vector<uint32_t> out(keys.size());
+    size_t mismatch = 0;
+    for (size_t len : lens) {
+        h.hash_many(&keys[0], &out[0], len);
+        for (size_t i = 0; i < len; ++i)
+            mismatch += (out[i] != h(keys[i]));
+    }
+    if (mismatch)
+        cerr << "ERROR: " << name << " (" << dist << ") batch output differs from scalar for "
+             << mismatch << " keys" << endl;
+    return mismatch;
+}
+
+template <class F>
+void benchWide(const F& h, const vector<typename F::key_type>& keys, const bench_config& cfg,
+               const string& name, const string& dist, true_type)
+{
+    bench_result r;
+    bench_measure(r, cfg.reps, keys.size(), false, [&]() { return runBatchWide(h, keys, keys.size()); });
+    record(name, dist, "batch-wide", r);
+}
+
+template <class F>
+void benchWide(const F&, const vector<typename F::key_type>&, const bench_config&,
+               const string&, const string&, false_type)
+{
+}
+
+template <class F>
+void benchHasher(const bench_config& cfg, const string& name, function<void(F&)> init = function<void(F&)>())
+{
+    typedef typename F::key_type key_type;
+    if (!cfg.filter.empty() && name.find(cfg.filter) == string::npos)
+        return;
+
+    F h;
+    if (init)
+        init(h);
+    else
+        h.init(hash_seed(cfg.seed));
+
+    const char* dists[] = { "sequential", "random", "dense" };
+    for (const char* dist : dists) {
+        vector<key_type> keys = makeKeys<key_type>(dist, cfg.keys, cfg.seed + 1);
+        size_t n = keys.size();
+        size_t nc = min(cfg.cold_keys, n);
+        bench_result r;
+
+        bench_measure(r, cfg.reps, n, false, [&]() { return runThroughput(h, keys, n); });
+        record(name, dist, "throughput", r);
+        bench_measure(r, cfg.reps, n, false, [&]() { return runLatency(h, keys, n); });
+        record(name, dist, "latency", r);
+        bench_measure(r, cfg.reps, n, false, [&]() { return runBatch(h, keys, n); });
+        record(name, dist, "batch", r);
+        benchWide(h, keys, cfg, name, dist, integral_constant<bool, (hash_outputs<F>::value > 1)>());
+
+        bench_measure(r, cfg.reps, nc, true, [&]() { return runThroughput(h, keys, nc); });
+        record(name, dist, "throughput", r);
+        bench_measure(r, cfg.reps, nc, true, [&]() { return runBatch(h, keys, nc); });
+        record(name, dist, "batch", r);
+
+        batch_errors += checkBatch(h, keys, name, dist);
+    }
+}
+
+#ifdef HASHING_X86_SIMD
+// CityHashCrc on long random keys, e.g. shingles of documents. Only the
+// throughput modes apply. Keys of at most 900 bytes are hashed without
+// crc32 by CityHash128WithSeed, so lengths on both sides of the cutoff are
+// measured. Skipped if the CPU has no SSE4.2 or HASHING_SIMD disables it.
+void benchLong(const bench_config& cfg, size_t trials, size_t len)
+{
+    string name = "CityHashCrc (" + to_string(len) + " byte keys)";
+    if (!cfg.filter.empty() && name.find(cfg.filter) == string::npos)
+        return;
+    if (!citycrcwrap::available()) {
+        cerr << "Skipping " << name << ": SSE4.2 not available" << endl;
+        return;
+    }
+
+    mt19937 rng(cfg.seed + 1);
+    vector<string> keys(trials);
+    for (size_t i = 0; i < trials; ++i)
+        for (size_t j = 0; j < len; ++j)
+            keys[i].push_back((char)rng());
+
+    citycrcwrap h;
+    h.init(hash_seed(cfg.seed));
+    bench_result r;
+    bench_measure(r, cfg.reps, trials, false, [&]() { return runThroughput(h, keys, trials); });
+    record(name, "random", "throughput", r);
+    bench_measure(r, cfg.reps, trials, false, [&]() { return runBatch(h, keys, trials); });
+    record(name, "random", "batch", r);
+    batch_errors += checkBatch(h, keys, name, "random");
+}
+#endif
+
+int main(int argc, char** argv)
+{
+    bench_config cfg;
+    cfg.keys = 1 << 20;
+    cfg.reps = 9;
+    cfg.cold_keys = 1000;
+    cfg.seed = 1;
+    for (int i = 1; i < argc; i += 2) {
+        string opt = argv[i];
+        if (i + 1 == argc) {
+            cerr << "Missing value for " << opt << endl;
+            return 1;
+        }
+        if (opt == "--keys")
+            cfg.keys = strtoull(argv[i+1], NULL, 10);
+        else if (opt == "--reps")
+            cfg.reps = strtoul(argv[i+1], NULL, 10);
+        else if (opt == "--cold-keys")
+            cfg.cold_keys = strtoull(argv[i+1], NULL, 10);
+        else if (opt == "--seed")
+            cfg.seed = strtoull(argv[i+1], NULL, 10);
+        else if (opt == "--filter")
+            cfg.filter = argv[i+1];
+        else if (opt == "--json")
+            cfg.json = argv[i+1];
+        else {
+            cerr << "Unknown option " << opt << endl;
+            return 1;
+        }
+    }
+    if (cfg.keys == 0 || cfg.reps == 0) {
+        cerr << "--keys and --reps must be positive" << endl;
+        return 1;
+    }
+
+    cout << "SIMD level: " << simd_level_name(cpu_simd_level()) << ", " << cfg.keys
+         << " keys, " << cfg.reps << " repetitions (median ns/key)" << endl;
+    bench_report::print_header(cout);
+
+    benchHasher<multishift>(cfg, "Multiply-shift");
+    benchHasher<mixedtab>(cfg, "Mixed tabulation");
+    benchHasher<mixedtab128>(cfg, "Mixed tabulation (3 outputs)");
+    benchHasher<polyhash2>(cfg, "2-wise PolyHash");
+    benchHasher<polyhash3>(cfg, "3-wise PolyHash");
+    benchHasher<polyhash>(cfg, "20-wise PolyHash (runtime degree)",
+                          [&](polyhash& h) { h.init(20, hash_seed(cfg.seed)); });
+    benchHasher<polyhash_k<20>>(cfg, "20-wise PolyHash");
+    benchHasher<murmurwrap>(cfg, "MurmurHash3");
+    benchHasher<murmur128wrap>(cfg, "MurmurHash3 x64_128 (4 outputs)");
+    benchHasher<citywrap>(cfg, "CityHash");
+    benchHasher<crc32hash>(cfg, "CRC32C");
+    benchHasher<blake2wrap>(cfg, "Blake2");
+    benchHasher<simpletab>(cfg, "Simple Tabulation");
+    benchHasher<twisttab>(cfg, "Twisted Tabulation");
+    benchHasher<tornadotab>(cfg, "Tornado Tabulation");
+
+    benchHasher<multishift64>(cfg, "Multiply-shift (64-bit keys)");
+    benchHasher<mixedtab64>(cfg, "Mixed tabulation (64-bit keys)");
+    benchHasher<simpletab64>(cfg, "Simple Tabulation (64-bit keys)");
+    benchHasher<twisttab64>(cfg, "Twisted Tabulation (64-bit keys)");
+    benchHasher<tornadotab64>(cfg, "Tornado Tabulation (64-bit keys)");
+    benchHasher<murmurwrap64>(cfg, "MurmurHash3 (64-bit keys)");
+    benchHasher<citywrap64>(cfg, "CityHash (64-bit keys)");
+    benchHasher<crc32hash64>(cfg, "CRC32C (64-bit keys)");
+
+#ifdef HASHING_X86_SIMD
+    benchLong(cfg, 1 << 16, 64);
+    benchLong(cfg, 1 << 15, 512);
+    benchLong(cfg, 1 << 14, 1024);
+#endif
+
+    if (!cfg.json.empty()) {
+        vector<pair<string, string>> context;
+        context.push_back(make_pair("simd_level", string(simd_level_name(cpu_simd_level()))));
+        context.push_back(make_pair("keys", to_string(cfg.keys)));
+        context.push_back(make_pair("reps", to_string(cfg.reps)));
+        context.push_back(make_pair("cold_keys", to_string(cfg.cold_keys)));
+        context.push_back(make_pair("seed", to_string(cfg.seed)));
+        context.push_back(make_pair("compiler", string(__VERSION__)));
+        ofstream fout(cfg.json.c_str());
+        if (!fout) {
+            cerr << "Cannot write " << cfg.json << endl;
+            return 1;
+        }
+        report.write_json(fout, context);
+    }
+
+    if (batch_errors) {
+        cerr << "ERROR: batch output differs from scalar for " << batch_errors << " keys" << endl;
+        return 1;
+    }
+    return 0;
 }